@@ -1,404 +1,440 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <fcntl.h>
-#include <sys/ioctl.h>
 #include <time.h>
-#include <linux/i2c-dev.h>
+#include <limits.h>
+#include <signal.h>
 
-#define CLOCK_DEV "/dev/clock_drv"
+#include "clock_client.h"
+#include "di_engine.h"
+#include "history.h"
+#include "metrics.h"
+#include "oled.h"
+#include "render.h"
 
 
-#define I2C_DEV "/dev/i2c-1"
-#define OLED_I2C_ADDR 0x3C
+#define MAX_PANELS 4
 
-#define OLED_W 128
-#define OLED_H 64
-static uint8_t fb[OLED_W * OLED_H / 8];
+struct panel {
+    struct oled oled;
+    int follow;             /* 1 = UI page + page, 0 = fixed page */
+    int page;
+    int shown;              /* page last presented, -1 = none yet */
+};
 
-static int i2c_fd = -1;
+static struct panel panels[MAX_PANELS];
+static int npanels;
+static int transition_style = 1;    /* 0 none, 1 roll, 2 slide */
 
-static long long now_ms(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL;
-}
+static struct clock_client clk;
 
-static int iround_div(long long sum, int cnt) {
-    if (cnt <= 0) return -1;
-    if (sum >= 0) return (int)((sum + cnt/2) / cnt);
-    return (int)((sum - cnt/2) / cnt);
-}
+/* every time source goes through the client so a replay runs on trace time */
+static long long now_ms(void) { return clock_client_now_ms(&clk); }
+static struct di_engine di_eng;
+static struct history hist;
+static int hist_on;
 
+static int cur_temp = -1;
+static int cur_hum  = -1;
 
-static int i2c_open_oled(void) {
-    i2c_fd = open(I2C_DEV, O_RDWR);
-    if (i2c_fd < 0) { perror("open i2c"); return -1; }
-    if (ioctl(i2c_fd, I2C_SLAVE, OLED_I2C_ADDR) < 0) {
-        perror("ioctl I2C_SLAVE");
-        close(i2c_fd);
-        i2c_fd = -1;
-        return -1;
-    }
-    return 0;
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig) { (void)sig; quit = 1; }
+
+static int panel_page(const struct panel *p, int ui_page) {
+    if (p->follow) return (ui_page + p->page) % UI_PAGES;
+    return p->page % UI_PAGES;
 }
 
-static void oled_cmd(uint8_t c) {
-    uint8_t buf[2] = {0x00, c};
-    (void)write(i2c_fd, buf, 2);
+/* the encoder turns one page at a time, so the short way round is the direction */
+static enum oled_transition page_transition(int from, int to) {
+    if (from < 0 || from == to || !transition_style) return OLED_TR_NONE;
+
+    int fwd = (to - from + UI_PAGES) % UI_PAGES <= UI_PAGES / 2;
+    if (transition_style == 2) return fwd ? OLED_TR_SLIDE_LEFT : OLED_TR_SLIDE_RIGHT;
+    return fwd ? OLED_TR_ROLL_UP : OLED_TR_ROLL_DOWN;
 }
 
-static void oled_data_chunk(const uint8_t *d, size_t n) {
-    uint8_t buf[1 + 16];
-    while (n > 0) {
-        size_t m = (n > 16) ? 16 : n;
-        buf[0] = 0x40;
-        memcpy(&buf[1], d, m);
-        (void)write(i2c_fd, buf, 1 + m);
-        d += m;
-        n -= m;
+/*
+ * Every distinct page is rendered once per frame, straight into the back
+ * buffer of the first panel that shows it; other panels on the same page
+ * get a copy.  Panels whose frame did not change are not flushed at all.
+ */
+static void render_panels(const struct clock_status *st, int blink) {
+    uint8_t *rendered[UI_PAGES] = {0};
+    struct render_data d = { cur_temp, cur_hum, &di_eng, hist_on ? &hist : NULL };
+
+    for (int i = 0; i < npanels; i++) {
+        int pg = panel_page(&panels[i], st->page);
+        uint8_t *back = oled_back(&panels[i].oled);
+
+        if (rendered[pg]) {
+            memcpy(back, rendered[pg], OLED_FB_SIZE);
+        } else {
+            render_page(back, pg, st, blink, &d);
+            rendered[pg] = back;
+        }
     }
-}
 
-static void oled_init(void) {
-    oled_cmd(0xAE);
-    oled_cmd(0xD5); oled_cmd(0x80);
-    oled_cmd(0xA8); oled_cmd(0x3F);
-    oled_cmd(0xD3); oled_cmd(0x00);
-    oled_cmd(0x40);
-    oled_cmd(0x8D); oled_cmd(0x14);
-    oled_cmd(0x20); oled_cmd(0x00);
-    oled_cmd(0xA1);
-    oled_cmd(0xC8);
-    oled_cmd(0xDA); oled_cmd(0x12);
-    oled_cmd(0x81); oled_cmd(0xCF);
-    oled_cmd(0xD9); oled_cmd(0xF1);
-    oled_cmd(0xDB); oled_cmd(0x40);
-    oled_cmd(0xA4);
-    oled_cmd(0xA6);
-    oled_cmd(0xAF);
+    for (int i = 0; i < npanels; i++) {
+        struct panel *p = &panels[i];
+        int pg = panel_page(p, st->page);
+
+        oled_present_tr(&p->oled, page_transition(p->shown, pg));
+        p->shown = pg;
+    }
 }
 
-static void oled_flush(void) {
-    oled_cmd(0x21); oled_cmd(0); oled_cmd(127);
-    oled_cmd(0x22); oled_cmd(0); oled_cmd(7);
-    oled_data_chunk(fb, sizeof(fb));
+/*
+ * Frame scheduling: instead of a fixed 5 fps the loop sleeps until the next
+ * moment something on screen can change -- the next second on the clock
+ * page, the next DHT sample on the sensor pages, the next history sample on
+ * the graphs -- or until the driver reports input.  Edit mode and the first
+ * few seconds after input run at FRAME_FAST_MS so the UI stays responsive.
+ */
+#define FRAME_FAST_MS    100
+#define FRAME_SLOW_MS    200        /* pacing when the driver cannot poll */
+#define INPUT_HOLD_MS    3000
+#define SEC_EARLY_MS     30         /* wake this early for the next second, then step */
+#define SEC_STEP_MS      25
+#define SEC_LATE_MS      200
+#define DHT_PERIOD_MS    2000
+#define NODEV_RETRY_MS   1000
+#define POLL_FALSE_MAX   8          /* instant wakeups without input before giving up on poll */
+
+#define CONTRAST_DIM     0x01
+
+static int dim_s = 60, off_s = 600;
+
+static int ui_input_changed(const struct clock_status *a, const struct clock_status *b) {
+    if (a->page != b->page || a->win != b->win) return 1;
+    if (strcmp(a->mode, b->mode) || strcmp(a->field, b->field)) return 1;
+    /* in edit mode the encoder moves the time itself */
+    if (strcmp(a->mode, "EDIT") == 0 &&
+        (a->hh != b->hh || a->mm != b->mm || a->ss != b->ss)) return 1;
+    return 0;
 }
 
+static long long min_ll(long long a, long long b) { return a < b ? a : b; }
 
-static void fb_clear(void) { memset(fb, 0, sizeof(fb)); }
+static void set_panels_power(int on, int contrast) {
+    for (int i = 0; i < npanels; i++)
+        oled_set_power(&panels[i].oled, on, contrast);
+}
 
-static void fb_set_px(int x, int y, int on) {
-    if (x<0||x>=OLED_W||y<0||y>=OLED_H) return;
-    int idx = (y/8)*OLED_W + x;
-    uint8_t mask = (1u << (y%8));
-    if (on) fb[idx] |= mask;
-    else    fb[idx] &= ~mask;
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-b backend] [-c cpu] [-H file[:raw,min,hour]] [-I dim_s,off_s]\n"
+                    "          [-m socket] [-P page[,dev[,addr[,backend]]]]... [-s broker_socket]\n"
+                    "          [-T none|roll|slide] [-r trace | -R trace[:speed]]\n"
+                    "  -b backend  i2c (default), sim[:bus_khz], pbm[:dir | :file.pbm]\n"
+                    "  -c cpu      pin the OLED transport threads to this core\n"
+                    "  -H file     record sensor history; optional ring sizes in records\n"
+                    "  -I dim,off  dim / switch off the panels after this many idle seconds,\n"
+                    "              0 disables a step (default 60,600)\n"
+                    "  -m socket   serve metrics on this unix socket\n"
+                    "  -r trace    record everything read from / written to the driver\n"
+                    "  -R trace    replay a recording instead of using the driver; speed is a\n"
+                    "              factor of real time, 0 = as fast as possible (default 1)\n"
+                    "  -P spec     add a panel showing a fixed page (N) or the UI page + N (+N);\n"
+                    "              defaults: %s, 0x3D, the -b backend\n"
+                    "  -s socket   read state from brokerd instead of %s\n"
+                    "  -T style    page change animation done by the panel (default roll)\n",
+                    prog, I2C_DEV, CLOCK_DEV);
 }
 
-static const uint8_t font5x7_digits[][5] = {
-    {0x3E,0x51,0x49,0x45,0x3E},{0x00,0x42,0x7F,0x40,0x00},
-    {0x42,0x61,0x51,0x49,0x46},{0x21,0x41,0x45,0x4B,0x31},
-    {0x18,0x14,0x12,0x7F,0x10},{0x27,0x45,0x45,0x45,0x39},
-    {0x3C,0x4A,0x49,0x49,0x30},{0x01,0x71,0x09,0x05,0x03},
-    {0x36,0x49,0x49,0x49,0x36},{0x06,0x49,0x49,0x29,0x1E}
-};
-static const uint8_t font_colon[5] = {0x00,0x36,0x36,0x00,0x00};
-
-static const uint8_t font_E[5]={0x7F,0x49,0x49,0x49,0x41};
-static const uint8_t font_D[5]={0x7F,0x41,0x41,0x22,0x1C};
-static const uint8_t font_I[5]={0x00,0x41,0x7F,0x41,0x00};
-static const uint8_t font_T[5]={0x01,0x01,0x7F,0x01,0x01};
-static const uint8_t font_R[5]={0x7F,0x09,0x19,0x29,0x46};
-static const uint8_t font_U[5]={0x3F,0x40,0x40,0x40,0x3F};
-static const uint8_t font_N[5]={0x7F,0x06,0x18,0x60,0x7F};
-static const uint8_t font_W[5]={0x7F,0x20,0x18,0x20,0x7F};
-static const uint8_t font_H[5]={0x7F,0x08,0x08,0x08,0x7F};
-static const uint8_t font_M[5]={0x7F,0x02,0x04,0x02,0x7F};
-static const uint8_t font_S[5]={0x46,0x49,0x49,0x49,0x31};
-static const uint8_t font_G[5]={0x3E,0x41,0x41,0x51,0x32};
-static const uint8_t font_P[5]={0x7F,0x09,0x09,0x09,0x06};
-static const uint8_t font_A[5]={0x7E,0x09,0x09,0x09,0x7E};
-static const uint8_t font_B[5]={0x7F,0x49,0x49,0x49,0x36};
-
-
-
-
-static const uint8_t font_a[5]={0x20,0x54,0x54,0x54,0x78};
-static const uint8_t font_c[5]={0x38,0x44,0x44,0x44,0x20};
-static const uint8_t font_d[5]={0x38,0x44,0x44,0x48,0x7F};
-static const uint8_t font_e[5]={0x38,0x54,0x54,0x54,0x18};
-static const uint8_t font_g[5]={0x18,0xA4,0xA4,0xA4,0x7C};
-static const uint8_t font_h[5]={0x7F,0x08,0x04,0x04,0x78};
-static const uint8_t font_i[5]={0x00,0x44,0x7D,0x40,0x00};
-static const uint8_t font_l[5]={0x00,0x41,0x7F,0x40,0x00};
-static const uint8_t font_m[5]={0x7C,0x04,0x18,0x04,0x78};
-static const uint8_t font_n[5]={0x7C,0x08,0x04,0x04,0x78};
-static const uint8_t font_o[5]={0x38,0x44,0x44,0x44,0x38};
-static const uint8_t font_p[5]={0x7C,0x14,0x14,0x14,0x08};
-static const uint8_t font_r[5]={0x7C,0x08,0x04,0x04,0x08};
-static const uint8_t font_s[5]={0x48,0x54,0x54,0x54,0x20};
-static const uint8_t font_t[5]={0x04,0x3F,0x44,0x40,0x20};
-static const uint8_t font_u[5]={0x3C,0x40,0x40,0x20,0x7C};
-static const uint8_t font_w[5]={0x3C,0x40,0x30,0x40,0x3C};
-static const uint8_t font_y[5]={0x0C,0x50,0x50,0x50,0x3C};
-static const uint8_t font_space[5] = {0,0,0,0,0};
-
-static const uint8_t font_percent[5] = {0x23, 0x13, 0x08, 0x64, 0x62};
-static const uint8_t font_deg[5] = {0x06, 0x09, 0x09, 0x06, 0x00};
-static const uint8_t font_dot[5] = {0x00,0x60,0x60,0x00,0x00};
-
-
-static const uint8_t icon_good[8]   = { 0x3C,0x42,0xA5,0x81,0xA5,0x99,0x42,0x3C };
-static const uint8_t icon_Mild[8] = { 0x3C,0x42,0xA5,0x81,0xBD,0x81,0x42,0x3C };
-static const uint8_t icon_bad[8]    = { 0x3C,0x42,0xA5,0x81,0x99,0xA5,0x42,0x3C };
-static const uint8_t icon_hot[8]    = { 0x3C,0x42,0xA5,0x81,0x9D,0xA1,0x42,0x3C };
-
-static const uint8_t* glyph_for_char(char c) {
-    if (c>='0' && c<='9') return font5x7_digits[c-'0'];
-    if (c==':') return font_colon;
-
-    if (c=='E') return font_E; if (c=='D') return font_D; if (c=='I') return font_I;
-    if (c=='T') return font_T; if (c=='R') return font_R; if (c=='U') return font_U;
-    if (c=='N') return font_N; if (c=='W') return font_W; if (c=='H') return font_H;
-    if (c=='M') return font_M; if (c=='S') return font_S; if (c=='G') return font_G;
-    if (c=='P') return font_P; if (c=='A') return font_A; if (c=='B') return font_B;
-
-
-    if (c=='a') return font_a; if (c=='c') return font_c; if (c=='d') return font_d;
-    if (c=='e') return font_e; if (c=='g') return font_g; if (c=='h') return font_h;
-    if (c=='i') return font_i; if (c=='l') return font_l; if (c=='m') return font_m;
-    if (c=='n') return font_n; if (c=='o') return font_o; if (c=='p') return font_p;
-    if (c=='r') return font_r; if (c=='s') return font_s; if (c=='t') return font_t;
-    if (c=='u') return font_u; if (c=='w') return font_w; if (c=='y') return font_y;
-    if (c=='%') return font_percent; if (c==0xB0) return font_deg; if (c=='.') return font_dot;
-    if (c==' ') return font_space;
-    return NULL;
+static int open_history(char *spec) {
+    uint32_t cap[3] = { HIST_RAW_CAP_DEFAULT, HIST_MIN_CAP_DEFAULT, HIST_HOUR_CAP_DEFAULT };
+    char *sizes = strrchr(spec, ':');
+
+    if (sizes) {
+        *sizes++ = 0;
+        sscanf(sizes, "%u,%u,%u", &cap[0], &cap[1], &cap[2]);
+    }
+    return history_open(&hist, spec, cap[0], cap[1], cap[2]);
 }
 
-static void fb_draw_char5x7(int x, int y, char c, int scale) {
-    const uint8_t *g = glyph_for_char(c);
-    if (!g) return;
-    for (int i=0;i<5;i++) {
-        for (int j=0;j<7;j++) {
-            if ((g[i] >> j) & 1) {
-                for (int sx=0;sx<scale;sx++)
-                    for (int sy=0;sy<scale;sy++)
-                        fb_set_px(x+i*scale+sx, y+j*scale+sy, 1);
-            }
+/* "file[:speed]"; a suffix that is not a number is part of the file name */
+static int open_replay(char *spec) {
+    double speed = 1.0;
+    char *colon = strrchr(spec, ':');
+
+    if (colon) {
+        char *end;
+        double v = strtod(colon + 1, &end);
+        if (end != colon + 1 && *end == 0 && v >= 0) {
+            *colon = 0;
+            speed = v;
         }
     }
+    return clock_client_open_replay(&clk, spec, speed);
 }
 
-static void fb_draw_text(int x, int y, const char *s, int scale, int spacing) {
-    while (*s) {
-        fb_draw_char5x7(x, y, *s++, scale);
-        x += 5*scale + spacing;
+/* "dim_s[,off_s]", seconds >= 0 */
+static int parse_idle(const char *spec) {
+    char *end;
+    long dim = strtol(spec, &end, 10), off = off_s;
+
+    if (end == spec || dim < 0 || dim > INT_MAX / 1000) return -1;
+    if (*end == ',') {
+        const char *s = end + 1;
+        off = strtol(s, &end, 10);
+        if (end == s || off < 0 || off > INT_MAX / 1000) return -1;
     }
-}
+    if (*end) return -1;
 
-static int di_to_led(int di)
-{
-    if (di < 65) return 0;
-    if (di > 80) return 8;
+    dim_s = (int)dim;
+    off_s = (int)off;
+    return 0;
+}
 
-    return 1 + (di - 65) * 7 / 15;
+static int add_panel(const char *backend, const char *dev, int addr, int follow, int page) {
+    struct panel *p;
+
+    if (npanels == MAX_PANELS) { fprintf(stderr, "too many panels\n"); return -1; }
+    p = &panels[npanels];
+    if (oled_open(&p->oled, backend, dev, addr) != 0) return -1;
+    oled_init(&p->oled);
+    p->follow = follow;
+    p->page = page;
+    p->shown = -1;
+    npanels++;
+    return 0;
 }
 
-static void set_led_level(int level)
-{
-    char buf[32];
-    snprintf(buf, sizeof(buf), "LED %d", level);
+/* "page[,dev[,addr[,backend]]]", page is N (fixed) or +N (follow the UI) */
+static int add_panel_spec(char *spec, const char *def_backend) {
+    char *fields[4] = { NULL, I2C_DEV, "0x3D", NULL };
+    int n = 0;
 
-    int fd = open(CLOCK_DEV, O_WRONLY);
-    if (fd >= 0) {
-        write(fd, buf, strlen(buf));
-        close(fd);
-    }
-}
+    for (char *tok = strtok(spec, ","); tok && n < 4; tok = strtok(NULL, ","))
+        fields[n++] = tok;
 
-static void fb_draw_icon8(int x, int y, const uint8_t icon[8], int scale) {
-    for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            if (icon[r] & (1 << c)) {
-                for (int sx = 0; sx < scale; sx++) {
-                    for (int sy = 0; sy < scale; sy++) {
-                        fb_set_px(x + c*scale + sx, y + r*scale + sy, 1);
-                    }
-                }
-            }
-        }
+    int follow = (fields[0][0] == '+');
+    char *end;
+    long page = strtol(fields[0] + follow, &end, 10);
+    if (end == fields[0] + follow || *end || page < 0 || page >= UI_PAGES) {
+        fprintf(stderr, "-P: page must be 0..%d or +0..+%d\n", UI_PAGES - 1, UI_PAGES - 1);
+        return -1;
     }
+    int addr = (int)strtol(fields[2], NULL, 0);
+    return add_panel(fields[3] ? fields[3] : def_backend, fields[1], addr, follow, (int)page);
 }
 
-static void fb_draw_circle(int cx,int cy,int r,int filled){
-    for(int y=-r;y<=r;y++){
-        for(int x=-r;x<=r;x++){
-            int d=x*x+y*y;
-            int rr=r*r;
-            if(filled){ if(d<=rr) fb_set_px(cx+x,cy+y,1); }
-            else{ if(d>=rr-r && d<=rr+r) fb_set_px(cx+x,cy+y,1); }
+int main(int argc, char **argv) {
+    const char *backend = "i2c";
+    char *hist_path = NULL;
+    const char *metrics_path = NULL;
+    const char *broker_path = NULL;
+    const char *record_path = NULL;
+    char *replay_spec = NULL;
+    char *panel_specs[MAX_PANELS];
+    int nspecs = 0;
+    int transport_cpu = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:c:H:I:m:P:r:R:s:T:h")) != -1) {
+        switch (opt) {
+        case 'b': backend = optarg; break;
+        case 'c': transport_cpu = atoi(optarg); break;
+        case 'H': hist_path = optarg; break;
+        case 'I':
+            if (parse_idle(optarg) != 0) { usage(argv[0]); return 1; }
+            break;
+        case 'm': metrics_path = optarg; break;
+        case 'r': record_path = optarg; break;
+        case 'R': replay_spec = optarg; break;
+        case 's': broker_path = optarg; break;
+        case 'T':
+            if      (strcmp(optarg, "none")  == 0) transition_style = 0;
+            else if (strcmp(optarg, "roll")  == 0) transition_style = 1;
+            else if (strcmp(optarg, "slide") == 0) transition_style = 2;
+            else { usage(argv[0]); return 1; }
+            break;
+        case 'P':
+            /* the first panel is always the default one */
+            if (nspecs == MAX_PANELS - 1) { fprintf(stderr, "too many panels\n"); return 1; }
+            panel_specs[nspecs++] = optarg;
+            break;
+        default:  usage(argv[0]); return opt == 'h' ? 0 : 1;
         }
     }
-}
-static void draw_page_dots(int page){
-    int cy=60,r=3;
-    int cx1=OLED_W/2-15;
-    int cx2=OLED_W/2;
-    int cx3=OLED_W/2+15;
-    fb_draw_circle(cx1,cy,r,0);
-    fb_draw_circle(cx2,cy,r,0);
-    fb_draw_circle(cx3,cy,r,0);
-    if(page==0) fb_draw_circle(cx1,cy,r-1,1);
-    else if(page==1) fb_draw_circle(cx2,cy,r-1,1);
-    else fb_draw_circle(cx3,cy,r-1,1);
-}
 
-static int read_clock_line(char *out, size_t outsz) {
-    int fd = open(CLOCK_DEV, O_RDONLY);
-    if (fd < 0) return -1;
-    int n = read(fd, out, outsz-1);
-    close(fd);
-    if (n <= 0) return -1;
-    out[n] = 0;
-    return 0;
-}
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (add_panel(backend, I2C_DEV, OLED_I2C_ADDR, 1, 0) != 0) return 1;
+    for (int i = 0; i < nspecs; i++)
+        if (add_panel_spec(panel_specs[i], backend) != 0) return 1;
+
+    /* one transport thread per panel, so panels on different buses flush in parallel */
+    for (int i = 0; i < npanels; i++)
+        if (oled_start(&panels[i].oled, transport_cpu) != 0) return 1;
+
+    /* without the driver the UI still runs and shows "--" until it appears */
+    if (replay_spec) {
+        if (open_replay(replay_spec) != 0) return 1;
+    } else {
+        if (broker_path) clock_client_open_broker(&clk, broker_path);
+        else             clock_client_open(&clk, CLOCK_DEV);
+        if (record_path && clock_client_record(&clk, record_path) != 0) return 1;
+    }
 
-int main(void) {
-    if (i2c_open_oled() != 0) return 1;
-    oled_init();
+    if (hist_path) {
+        if (open_history(hist_path) != 0) return 1;
+        hist_on = 1;
+    }
 
-    int blink = 0;
-    int prev_page = 0;
+    for (int i = 0; i < npanels; i++)
+        metrics_add_display(&panels[i].oled);
+    metrics_set_client(&clk);
+    if (metrics_path && metrics_serve(metrics_path) != 0) return 1;
 
     long long last_dht_ms = 0;
-    int cur_temp = -1;
-    int cur_hum  = -1;
-
-    while (1) {
-        char line[200];
-        char mode[8]="RUN";
-        char field[8]="SEC";
-        int hh=0,mm=0,ss=0,page=0;
-        int temp=-1,hum=-1;
-
-        if (read_clock_line(line,sizeof(line))==0) {
-            sscanf(line,"%d:%d:%d MODE=%7s FIELD=%7s PAGE=%d TEMP=%d HUM=%d",
-                   &hh,&mm,&ss,mode,field,&page,&temp,&hum);
-        }
+    long long last_hist_ms = 0;
+
+    struct clock_status prev;
+    int has_prev = 0;
+    long long last_input_ms = now_ms();
+    long long sec_tick_ms = 0;          /* when ss was first seen to change */
+    int power_on = 1, power_contrast = OLED_CONTRAST_DEFAULT;
+    int poll_ok = 1, poll_false = 0, woke = 0, woke_instantly = 0;
+
+    di_engine_init(&di_eng);
+    render_init();
+
+    long long replay_t0 = metrics_now_us();
+
+    while (!quit && !clock_client_done(&clk)) {
+        struct clock_status st;
+        int dev_ok = (clock_client_read(&clk, &st) == 0);
+        int temp = st.temp, hum = st.hum;
 
         long long now = now_ms();
+        int input = 0;
+
+        /*
+         * The driver only signals poll for encoder and button events, so a
+         * wakeup is input even when no field changed (a short press on pages
+         * 0-2, a turn inside the page debounce).  brokerd and a replay also
+         * wake on the ticking clock and only count through the fields.
+         */
+        int touched = woke && poll_ok && !clk.broker && !clk.replay;
+
+        if (dev_ok) {
+            if (has_prev && ui_input_changed(&st, &prev)) input = 1;
+            /* the turn that wakes a dark panel only wakes it */
+            if (has_prev && (input || touched) && st.page != prev.page &&
+                (!power_on || power_contrast == CONTRAST_DIM)) {
+                clock_client_set_page(&clk, prev.page);
+                st.page = prev.page;
+            }
+            if (!has_prev || st.ss != prev.ss) sec_tick_ms = now;
+            prev = st;
+            has_prev = 1;
+        }
+        if (input || touched) last_input_ms = now;
 
-        
-        if ((page == 1 || page == 2) && (now - last_dht_ms >= 2000)) {
+        /* an old driver without .poll is always readable; fall back to pacing */
+        if (woke_instantly && !input) {
+            if (++poll_false >= POLL_FALSE_MAX) poll_ok = 0;
+        } else if (!woke_instantly) {
+            poll_false = 0;
+        }
+
+        if (now - last_dht_ms >= DHT_PERIOD_MS) {
+            atomic_fetch_add(&metrics.sensor_samples, 1);
             if (temp >= 0 && hum >= 0) {
                 cur_temp = temp;
                 cur_hum  = hum;
+                di_engine_update(&di_eng, temp, hum);
             }
+            if (dev_ok && temp >= DI_T_MIN && temp <= DI_T_MAX && hum >= DI_H_MIN && hum <= DI_H_MAX)
+                atomic_store(&metrics.sensor_last_ok_ms, now);
+            else
+                atomic_fetch_add(&metrics.sensor_invalid, 1);
+            atomic_store(&metrics.di_x10, di_eng.di_x10);
             last_dht_ms = now;
         }
 
-        fb_clear();
-        draw_page_dots(page);
-
-        
-        if (page==0) {
-            if (strcmp(mode,"EDIT")==0)
-                fb_draw_text(0,0,"EDIT",1,1);
-            else
-                fb_draw_text(0,0,"RUN",1,1);
-
-            if (strcmp(mode,"EDIT")==0) {
-                char hs[3], ms[3], ss_s[3];
-                sprintf(hs,"%02d",hh);
-                sprintf(ms,"%02d",mm);
-                sprintf(ss_s,"%02d",ss);
-
-                if (!(strcmp(field,"HOUR")==0 && blink)) fb_draw_text(10,18,hs,2,2);
-                fb_draw_text(34,18,":",2,2);
-                if (!(strcmp(field,"MIN")==0 && blink)) fb_draw_text(46,18,ms,2,2);
-                fb_draw_text(70,18,":",2,2);
-                if (!(strcmp(field,"SEC")==0 && blink)) fb_draw_text(82,18,ss_s,2,2);
-            } else {
-                char ts[16];
-                sprintf(ts,"%02d:%02d:%02d",hh,mm,ss);
-                fb_draw_text(10,18,ts,2,2);
-            }
+        if (hist_on && now - last_hist_ms >= HIST_SAMPLE_MS) {
+            int status = !dev_ok ? HIST_NO_DEVICE
+                       : (temp < 0 || hum < 0) ? HIST_NO_DATA : HIST_OK;
+            history_append(&hist, (uint32_t)clock_client_time(&clk), temp, hum, di_eng.di_x10, status);
+            last_hist_ms = now;
         }
 
-        
-        else if (page==1) {
-            const int num_x=92;
-
-            fb_draw_text(0,0,"Today Weather",1,1);
-            fb_draw_text(0,20,"Temp:",1,1);
-            fb_draw_text(0,38,"Humidity:",1,1);
-
-            char tstr[8], hstr[8];
-            
-            if (cur_temp >= 0) sprintf(tstr,"%02d",cur_temp);
-            else strcpy(tstr,"--");
-
-            if (cur_hum >= 0) sprintf(hstr,"%02d",cur_hum);
-            else strcpy(hstr,"--");
-
-            fb_draw_text(num_x,16,tstr,2,2);
-            fb_draw_text(num_x+22,16,"\xB0",1,1);   
-            fb_draw_text(num_x+30,16,"C",1,1);      
-
-            fb_draw_text(num_x,34,hstr,2,2);
-            fb_draw_text(num_x+24,34,"%",1,1);     
+        if (di_engine_value(&di_eng) >= 0)
+            clock_client_set_led(&clk, di_eng.level);
+
+        /* idle power: dim first, then blank; any input brings the panels back */
+        long long idle = now - last_input_ms;
+        int edit = dev_ok && strcmp(st.mode, "EDIT") == 0;
+        int want_on = edit || !off_s || idle < off_s * 1000LL;
+        int want_contrast = (edit || !dim_s || idle < dim_s * 1000LL)
+                          ? OLED_CONTRAST_DEFAULT : CONTRAST_DIM;
+        if (want_on != power_on || want_contrast != power_contrast) {
+            power_on = want_on;
+            power_contrast = want_contrast;
+            set_panels_power(power_on, power_contrast);
         }
 
-        
-        else {
-            int di=-1;
-            if (cur_temp >= 0 && cur_hum >= 0)
-                di = (int)(0.81*cur_temp + 0.01*cur_hum*(0.99*cur_temp-14.3) + 46.3);
-
-            fb_draw_text(0,0,"DI PAGE",1,1);
-
-
-            char di_str[8];
-            if (di>=0) sprintf(di_str,"%02d",di);
-            else strcpy(di_str,"--");
-
-            fb_draw_text(0,20,"DI:",2,2);        
-            fb_draw_text(40,20,di_str,2,2);    
-
-        if (di >= 0) {
-            int led = di_to_led(di);
-            set_led_level(led);
+        if (power_on) {
+            long long render_t0 = metrics_now_us();
+            render_panels(&st, (int)((now / 200) & 1));
+            metrics_hist_observe(&metrics.render_us, (unsigned long)(metrics_now_us() - render_t0));
+            atomic_fetch_add(&metrics.frames_rendered, 1);
         }
 
-        if (di < 0) {
-            fb_draw_text(40,14,"--",2,2);
-            fb_draw_text(0,36,"No Data",2,2);
-        }
-        else if (di < 68) {
-            fb_draw_icon8(90,20,icon_good,2);
-            fb_draw_text(0,36,"Good",2,2);
-        }
-        else if (di < 75) {
-            fb_draw_icon8(90,20,icon_Mild,2);
-            fb_draw_text(0,36,"Mild",2,2);
-        }
-        else if (di < 80) {
-            fb_draw_icon8(90,20,icon_bad,2);
-            fb_draw_text(0,36,"Bad",2,2);
-        }
-        else {
-            fb_draw_icon8(90,20,icon_hot,2);
-            fb_draw_text(0,36,"Hot",2,2);
+        clock_client_flush(&clk);
+        atomic_store(&metrics.led_level, clk.led_level);
+
+        /* earliest moment anything on any panel (or a sampler) is due */
+        long long due = last_dht_ms + DHT_PERIOD_MS;
+        if (hist_on) due = min_ll(due, last_hist_ms + HIST_SAMPLE_MS);
+        if (!dev_ok) due = min_ll(due, now + NODEV_RETRY_MS);
+        if (power_on) {
+            if (dim_s && power_contrast != CONTRAST_DIM)
+                due = min_ll(due, last_input_ms + dim_s * 1000LL);
+            if (off_s)
+                due = min_ll(due, last_input_ms + off_s * 1000LL);
+            if (edit || idle < INPUT_HOLD_MS)
+                due = min_ll(due, now + FRAME_FAST_MS);
+            for (int i = 0; i < npanels; i++) {
+                if (panel_page(&panels[i], st.page) != 0 || !dev_ok) continue;
+                long long since = now - sec_tick_ms;
+                if (since < 1000 - SEC_EARLY_MS)
+                    due = min_ll(due, sec_tick_ms + 1000 - SEC_EARLY_MS);
+                else if (since < 1000 + SEC_LATE_MS)
+                    due = min_ll(due, now + SEC_STEP_MS);
+                else        /* clock not ticking (stopped RTC): no point stepping */
+                    due = min_ll(due, now + FRAME_SLOW_MS);
+            }
         }
 
+        int timeout = (int)(due > now ? due - now : 0);
+        woke = woke_instantly = 0;
+        if (poll_ok) {
+            long long t0 = now_ms();
+            woke = clock_client_wait(&clk, timeout) > 0;
+            if (woke && timeout > 0)
+                woke_instantly = (now_ms() == t0);
+        } else {
+            clock_client_sleep(&clk, timeout < FRAME_SLOW_MS ? timeout : FRAME_SLOW_MS);
+        }
     }
 
-        oled_flush();
-        blink = !blink;
-        prev_page = page;
-        usleep(200000);
-    }
+    if (clk.replay)
+        fprintf(stderr, "replay: %.1f s of trace in %.2f s, %lu frames rendered\n",
+                clk.vend_us / 1e6, (metrics_now_us() - replay_t0) / 1e6,
+                atomic_load(&metrics.frames_rendered));
+
+    metrics_stop();
+    if (hist_on) history_close(&hist);
+    clock_client_close(&clk);
+    for (int i = 0; i < npanels; i++)
+        oled_close(&panels[i].oled);
     return 0;
 }
@@ -0,0 +1,238 @@
+/*
+ * bench: host micro-benchmarks for the UI hot paths.
+ *
+ * Each case runs until it has used about -t milliseconds and reports the
+ * mean time per call.  Flush cases go through the SSD1306 software model
+ * (the "sim" backend without bus timing), so besides ns/op they report the
+ * bytes and I2C transactions per frame; with the i2c backend every
+ * transaction is one write(2), so the latter is also syscalls per frame.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "clock_client.h"
+#include "di_engine.h"
+#include "history.h"
+#include "oled.h"
+#include "render.h"
+
+#define BENCH_MS_DEFAULT 200
+#define BENCH_HIST_SAMPLES 2000
+
+static const char status_line[] =
+    "12:34:56 MODE=RUN FIELD=SEC PAGE=3 TEMP=27 HUM=65 WIN=1\n";
+
+static const uint8_t icon[8] = { 0x3C,0x42,0xA5,0x81,0xA5,0x99,0x42,0x3C };
+
+static uint8_t frame[OLED_FB_SIZE];
+static struct clock_status st;
+static struct render_data rd;
+static struct di_engine di;
+static struct history hist;
+static struct oled oled;
+static struct clock_client cc;
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* per-op counters sampled around a run; NULL when the case has none */
+struct bench_counters {
+    const atomic_ulong *bytes;
+    const atomic_ulong *calls;
+    const char *calls_name;
+};
+
+struct bench {
+    const char *name;
+    void (*fn)(long i);
+    struct bench_counters ctr;
+};
+
+static void b_text1(long i)   { (void)i; fb_draw_text(0, 0, "12:34:56 Today", 1, 1); }
+static void b_text2(long i)   { (void)i; fb_draw_text(10, 18, "12:34:56", 2, 2); }
+static void b_circle(long i)  { (void)i; fb_draw_circle(64, 60, 3, 0); }
+static void b_disc(long i)    { (void)i; fb_draw_circle(64, 32, 20, 1); }
+static void b_dots(long i)    { draw_page_dots(i % UI_PAGES); }
+static void b_icon(long i)    { (void)i; fb_draw_icon8(90, 20, icon, 2); }
+
+static void b_page(int page, long i) {
+    st.ss = i % 60;
+    render_page(frame, page, &st, i & 1, &rd);
+}
+static void b_page0(long i) { b_page(0, i); }
+static void b_page1(long i) { b_page(1, i); }
+static void b_page2(long i) { b_page(2, i); }
+static void b_page3(long i) { b_page(3, i); }
+static void b_page4(long i) { b_page(4, i); }
+
+/* switching the window every frame forces a full replot of both graphs */
+static void b_page3_replot(long i) {
+    st.win = i & 1;
+    b_page(3, i);
+    st.win = 1;
+}
+
+static void b_parse(long i) {
+    (void)i;
+    clock_status_parse(status_line, &st);
+}
+
+static void b_client_read(long i) {
+    struct clock_status s;
+    (void)i;
+    clock_client_read(&cc, &s);
+}
+
+static void b_flush_full(long i) {
+    frame[i % OLED_FB_SIZE] ^= 1;
+    oled_flush(&oled, frame);
+}
+
+static void b_flush_page(long i) {
+    frame[3*OLED_W + i % OLED_W] ^= 1;      /* one dirty page, like a ticking second */
+    oled_flush_dirty(&oled, frame);
+}
+
+static void b_flush_same(long i) {
+    (void)i;
+    oled_flush_dirty(&oled, frame);
+}
+
+#define OLED_CTR { &oled.tx_bytes, &oled.tx_count, "tx" }
+
+static const struct bench benches[] = {
+    { "fb_draw_text scale 1",      b_text1,        { 0 } },
+    { "fb_draw_text scale 2",      b_text2,        { 0 } },
+    { "fb_draw_circle r3 outline", b_circle,       { 0 } },
+    { "fb_draw_circle r20 filled", b_disc,         { 0 } },
+    { "draw_page_dots",            b_dots,         { 0 } },
+    { "fb_draw_icon8 scale 2",     b_icon,         { 0 } },
+    { "render page 0 clock",       b_page0,        { 0 } },
+    { "render page 1 weather",     b_page1,        { 0 } },
+    { "render page 2 DI",          b_page2,        { 0 } },
+    { "render page 3 graphs",      b_page3,        { 0 } },
+    { "render page 3 replot",      b_page3_replot, { 0 } },
+    { "render page 4 DI graph",    b_page4,        { 0 } },
+    { "clock_status_parse",        b_parse,        { 0 } },
+    { "clock_client_read (file)",  b_client_read,  { NULL, &cc.syscalls, "syscalls" } },
+    { "oled_flush full",           b_flush_full,   OLED_CTR },
+    { "oled_flush_dirty 1 page",   b_flush_page,   OLED_CTR },
+    { "oled_flush_dirty same",     b_flush_same,   OLED_CTR },
+};
+
+static void run(const struct bench *b, long budget_ms, const char *filter) {
+    long n = 1;
+    long long t;
+
+    if (filter && !strstr(b->name, filter)) return;
+
+    /* grow the batch until it is long enough to time, then size it to the budget */
+    for (;;) {
+        long long t0 = now_ns();
+        for (long i = 0; i < n; i++) b->fn(i);
+        t = now_ns() - t0;
+        if (t >= 10000000LL || n >= (1L << 30)) break;
+        n *= 4;
+    }
+    n = (long)((double)n * budget_ms * 1000000.0 / (t > 0 ? t : 1));
+    if (n < 1) n = 1;
+
+    unsigned long bytes0 = b->ctr.bytes ? atomic_load(b->ctr.bytes) : 0;
+    unsigned long calls0 = b->ctr.calls ? atomic_load(b->ctr.calls) : 0;
+
+    long long t0 = now_ns();
+    for (long i = 0; i < n; i++) b->fn(i);
+    t = now_ns() - t0;
+
+    printf("%-28s %11ld %10.1f ns/op", b->name, n, (double)t / n);
+    if (b->ctr.bytes)
+        printf(" %8.1f bytes/op", (double)(atomic_load(b->ctr.bytes) - bytes0) / n);
+    if (b->ctr.calls)
+        printf(" %6.1f %s/op", (double)(atomic_load(b->ctr.calls) - calls0) / n, b->ctr.calls_name);
+    putchar('\n');
+    fflush(stdout);
+}
+
+static int setup_history(char *path) {
+    int fd = mkstemp(path);
+    if (fd < 0) { perror(path); return -1; }
+    close(fd);
+
+    if (history_open(&hist, path, BENCH_HIST_SAMPLES, 1440, 48) != 0) return -1;
+
+    /* synthetic day: slow temperature swing and humidity moving against it */
+    uint32_t ts = (uint32_t)time(NULL) - BENCH_HIST_SAMPLES * (HIST_SAMPLE_MS / 1000);
+    for (int i = 0; i < BENCH_HIST_SAMPLES; i++) {
+        int temp = 22 + (i / 40) % 9;
+        int hum = 70 - (i / 30) % 25;
+        history_append(&hist, ts, temp, hum, di_x10_exact(temp, hum), HIST_OK);
+        ts += HIST_SAMPLE_MS / 1000;
+    }
+    return history_commit(&hist);
+}
+
+static int setup_status_file(char *path) {
+    int fd = mkstemp(path);
+    if (fd < 0) { perror(path); return -1; }
+    if (write(fd, status_line, sizeof(status_line) - 1) != (ssize_t)(sizeof(status_line) - 1)) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    return clock_client_open(&cc, path);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-t ms] [filter]\n"
+                    "  -t ms    time budget per case (default %d)\n"
+                    "  filter   run only cases whose name contains this\n",
+            prog, BENCH_MS_DEFAULT);
+}
+
+int main(int argc, char **argv) {
+    char hist_path[] = "/tmp/bench_hist.XXXXXX";
+    char dev_path[] = "/tmp/bench_dev.XXXXXX";
+    long budget_ms = BENCH_MS_DEFAULT;
+    int opt, ret = 1;
+
+    while ((opt = getopt(argc, argv, "t:h")) != -1) {
+        switch (opt) {
+        case 't': budget_ms = atol(optarg); break;
+        default:  usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (budget_ms < 1) budget_ms = 1;
+
+    if (setup_history(hist_path) != 0) goto out_hist;
+    if (setup_status_file(dev_path) != 0) goto out_dev;
+    if (oled_open(&oled, "sim", NULL, OLED_I2C_ADDR) != 0) goto out_oled;
+    oled_init(&oled);
+
+    di_engine_init(&di);
+    di_engine_update(&di, 27, 65);
+    rd = (struct render_data){ 27, 65, &di, &hist };
+    clock_status_parse(status_line, &st);
+    render_init();
+    fb_target(frame);
+
+    for (size_t i = 0; i < sizeof(benches)/sizeof(benches[0]); i++)
+        run(&benches[i], budget_ms, optind < argc ? argv[optind] : NULL);
+    ret = 0;
+
+    oled_close(&oled);
+out_oled:
+    clock_client_close(&cc);
+out_dev:
+    unlink(dev_path);
+    history_close(&hist);
+out_hist:
+    unlink(hist_path);
+    return ret;
+}
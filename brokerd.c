@@ -0,0 +1,304 @@
+/*
+ * brokerd: the only reader of /dev/clock_drv.
+ *
+ * Reads the driver when it reports input (.poll) and once per clock
+ * second, and only while someone is subscribed, and publishes the status
+ * line to every subscriber on a SOCK_SEQPACKET unix socket, but only when it
+ * changed; while the driver cannot be read that "line" is
+ * CLOCK_BROKER_NODEV.  Subscribers send "LED n" / "SET hh:mm:ss" /
+ * "PAGE n" lines back; they go through one queue and reach the driver as
+ * at most one batched write per loop, with redundant commands dropped by
+ * clock_client.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "clock_client.h"
+
+#define MAX_SUBS        32
+#define CMDQ_LEN        64
+#define POLL_MS_DEFAULT 100        /* pacing when the driver cannot poll or the clock stands */
+#define SEC_EARLY_MS    30         /* read this early for the next second, then step */
+#define SEC_STEP_MS     25
+#define SEC_LATE_MS     200
+#define POLL_FALSE_MAX  8          /* readable without a change before giving up on .poll */
+
+enum cmd_type { CMD_LED, CMD_SET, CMD_PAGE };
+
+struct cmd {
+    enum cmd_type type;
+    int a, b, c;
+};
+
+struct sub {
+    int fd;
+    int behind;             /* last publish did not fit, resend when writable */
+};
+
+static struct clock_client clk;
+static struct sub subs[MAX_SUBS];
+static int nsubs;
+
+static struct cmd cmdq[CMDQ_LEN];
+static unsigned cmdq_head, cmdq_tail;
+
+static char state[CLOCK_LINE_MAX];
+static size_t state_len;
+
+static long long last_read_ms;
+static long long sec_tick_ms;       /* when ss was first seen to change */
+static int last_ss = -1;
+
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig) { (void)sig; quit = 1; }
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL;
+}
+
+static void cmdq_push(const struct cmd *c) {
+    if (cmdq_tail - cmdq_head == CMDQ_LEN) cmdq_head++;     /* drop the oldest */
+    cmdq[cmdq_tail++ % CMDQ_LEN] = *c;
+}
+
+static int cmdq_drain(void) {
+    int n = 0;
+
+    while (cmdq_head != cmdq_tail) {
+        const struct cmd *c = &cmdq[cmdq_head++ % CMDQ_LEN];
+        if      (c->type == CMD_LED)  clock_client_set_led(&clk, c->a);
+        else if (c->type == CMD_PAGE) clock_client_set_page(&clk, c->a);
+        else                          clock_client_set_time(&clk, c->a, c->b, c->c);
+        n++;
+    }
+    if (n) clock_client_flush(&clk);
+    return n;
+}
+
+static void parse_cmds(char *msg) {
+    char *save = NULL;
+    struct cmd c;
+
+    for (char *line = strtok_r(msg, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        if (sscanf(line, "LED %d", &c.a) == 1) {
+            c.type = CMD_LED;
+            cmdq_push(&c);
+        } else if (sscanf(line, "SET %d:%d:%d", &c.a, &c.b, &c.c) == 3) {
+            c.type = CMD_SET;
+            cmdq_push(&c);
+        } else if (sscanf(line, "PAGE %d", &c.a) == 1 && c.a >= 0 && c.a < CLOCK_PAGES) {
+            c.type = CMD_PAGE;
+            cmdq_push(&c);
+        }
+    }
+}
+
+static void sub_remove(int i) {
+    close(subs[i].fd);
+    subs[i] = subs[--nsubs];
+}
+
+static void sub_send(struct sub *s) {
+    if (state_len == 0) return;
+    ssize_t n = send(s->fd, state, state_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    s->behind = (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+static void publish(void) {
+    for (int i = 0; i < nsubs; i++)
+        sub_send(&subs[i]);
+}
+
+static int poll_device(void) {
+    char line[CLOCK_LINE_MAX];
+
+    struct clock_status st;
+
+    /* subscribers, present and future, must see the driver go away too */
+    last_read_ms = now_ms();
+    if (clock_client_read_line(&clk, line, sizeof(line)) != 0)
+        strcpy(line, CLOCK_BROKER_NODEV);
+    else if (clock_status_parse(line, &st) == 0 && st.ss != last_ss) {
+        last_ss = st.ss;
+        sec_tick_ms = last_read_ms;
+    }
+
+    size_t len = strlen(line);
+    if (len == state_len && memcmp(line, state, len) == 0) return 0;
+
+    memcpy(state, line, len);
+    state_len = len;
+    publish();
+    return 1;
+}
+
+/* next clock-driven read: just before the second turns, then in small steps */
+static long long next_read_ms(int dev_poll, int poll_ms) {
+    long long since = last_read_ms - sec_tick_ms;
+
+    if (!dev_poll || since >= 1000 + SEC_LATE_MS)
+        return last_read_ms + poll_ms;
+    if (since < 1000 - SEC_EARLY_MS)
+        return sec_tick_ms + 1000 - SEC_EARLY_MS;
+    return last_read_ms + SEC_STEP_MS;
+}
+
+static int listen_on(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "brokerd: socket path too long\n");
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-d device] [-s socket] [-i poll_ms]\n"
+                    "  -d device   driver node (default %s)\n"
+                    "  -s socket   subscriber socket (default %s)\n"
+                    "  -i poll_ms  read interval when the driver has no poll or the clock\n"
+                    "              stands still (default %d)\n",
+            prog, CLOCK_DEV, CLOCK_BROKER_SOCK, POLL_MS_DEFAULT);
+}
+
+int main(int argc, char **argv) {
+    const char *dev = CLOCK_DEV;
+    const char *sock_path = CLOCK_BROKER_SOCK;
+    int poll_ms = POLL_MS_DEFAULT;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:s:i:h")) != -1) {
+        switch (opt) {
+        case 'd': dev = optarg; break;
+        case 's': sock_path = optarg; break;
+        case 'i': poll_ms = atoi(optarg); break;
+        default:  usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (poll_ms < 10) poll_ms = 10;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    clock_client_open(&clk, dev);
+
+    int lfd = listen_on(sock_path);
+    if (lfd < 0) return 1;
+
+    int dev_poll = 1, poll_false = 0;
+
+    while (!quit) {
+        struct pollfd pfd[2 + MAX_SUBS];
+        long long now = now_ms();
+        int timeout = -1;               /* nobody subscribed: nothing to read for */
+        int npfd = 1 + nsubs;
+        int dev_slot = -1;
+
+        if (nsubs > 0) {
+            long long due = next_read_ms(dev_poll, poll_ms);
+            timeout = (due > now) ? (int)(due - now) : 0;
+        }
+
+        pfd[0].fd = lfd;
+        pfd[0].events = (nsubs < MAX_SUBS) ? POLLIN : 0;
+        for (int i = 0; i < nsubs; i++) {
+            pfd[1 + i].fd = subs[i].fd;
+            pfd[1 + i].events = POLLIN | (subs[i].behind ? POLLOUT : 0);
+        }
+        /* encoder and button input is published as soon as the driver has it */
+        if (nsubs > 0 && dev_poll && clk.fd >= 0) {
+            dev_slot = npfd++;
+            pfd[dev_slot].fd = clk.fd;
+            pfd[dev_slot].events = POLLIN;
+        }
+
+        int nready = poll(pfd, npfd, timeout);
+        if (nready < 0 && errno != EINTR) { perror("poll"); break; }
+
+        int input = nready > 0 && dev_slot >= 0 &&
+                    (pfd[dev_slot].revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL));
+
+        if (nready > 0) {
+            /* walk backwards so sub_remove() can swap in the last entry */
+            for (int i = nsubs - 1; i >= 0; i--) {
+                short re = pfd[1 + i].revents;
+
+                if (re & POLLIN) {
+                    char msg[256];
+                    ssize_t n = recv(subs[i].fd, msg, sizeof(msg) - 1, MSG_DONTWAIT);
+                    if (n > 0) {
+                        msg[n] = 0;
+                        parse_cmds(msg);
+                    } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                        sub_remove(i);
+                        continue;
+                    }
+                } else if (re & (POLLHUP | POLLERR)) {
+                    sub_remove(i);
+                    continue;
+                }
+                if ((re & POLLOUT) && subs[i].behind)
+                    sub_send(&subs[i]);
+            }
+
+            if (pfd[0].revents & POLLIN) {
+                int c = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+                if (c >= 0) {
+                    /* nothing was read while nobody listened */
+                    if (nsubs == 0) poll_device();
+                    subs[nsubs].fd = c;
+                    subs[nsubs].behind = 0;
+                    sub_send(&subs[nsubs]);
+                    nsubs++;
+                }
+            }
+        }
+
+        /* a command changes what the driver reports, so look again right away */
+        int read_now = cmdq_drain() > 0;
+
+        if (input) {
+            /* an old driver without .poll is always readable; fall back to pacing */
+            if (poll_device()) poll_false = 0;
+            else if (++poll_false >= POLL_FALSE_MAX) dev_poll = 0;
+        } else if (nsubs > 0 && (read_now || now_ms() >= next_read_ms(dev_poll, poll_ms))) {
+            poll_device();
+        }
+    }
+
+    for (int i = nsubs - 1; i >= 0; i--)
+        sub_remove(i);
+    close(lfd);
+    unlink(sock_path);
+    clock_client_close(&clk);
+    return 0;
+}
@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "clock_client.h"
+
+#define CLOCK_BROKER_WAIT_MS 200
+
+static int cc_connect(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) { errno = ENAMETOOLONG; return -1; }
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int cc_reopen(struct clock_client *cc) {
+    if (cc->fd >= 0 || cc->replay) return 0;
+    atomic_fetch_add(&cc->syscalls, 1);
+    if (cc->broker) cc->fd = cc_connect(cc->path);
+    else            cc->fd = open(cc->path, O_RDWR | O_CLOEXEC);
+    if (cc->fd < 0) { atomic_fetch_add(&cc->errors, 1); return -1; }
+    cc->led_level = -1;
+    cc->has_line = 0;
+    return 0;
+}
+
+static void cc_drop(struct clock_client *cc) {
+    if (cc->fd >= 0) close(cc->fd);
+    cc->fd = -1;
+}
+
+static int cc_open(struct clock_client *cc, const char *path, int broker) {
+    memset(cc, 0, sizeof(*cc));
+    cc->fd = -1;
+    cc->path = path;
+    cc->broker = broker;
+    cc->led_level = -1;
+    cc->pending_led = -1;
+    cc->pending_page = -1;
+    clock_status_init(&cc->last);
+
+    if (cc_reopen(cc) != 0) { perror(path); return -1; }
+    return 0;
+}
+
+int clock_client_open(struct clock_client *cc, const char *path) {
+    return cc_open(cc, path ? path : CLOCK_DEV, 0);
+}
+
+int clock_client_open_broker(struct clock_client *cc, const char *sock_path) {
+    return cc_open(cc, sock_path ? sock_path : CLOCK_BROKER_SOCK, 1);
+}
+
+int clock_client_open_replay(struct clock_client *cc, const char *path, double speed) {
+    struct trace_reader scan;
+    struct trace_event ev;
+    int r;
+
+    memset(cc, 0, sizeof(*cc));
+    cc->fd = -1;
+    cc->path = path;
+    cc->replay = 1;
+    cc->led_level = -1;
+    cc->pending_led = -1;
+    cc->pending_page = -1;
+    cc->speed = speed;
+    clock_status_init(&cc->last);
+
+    if (trace_open(&cc->rp, path) != 0) return -1;
+
+    /* find the end up front so the caller knows when playback is over */
+    scan = cc->rp;
+    while ((r = trace_next(&scan, &ev)) > 0)
+        cc->vend_us = ev.t_us;
+    if (r < 0) fprintf(stderr, "%s: corrupt record after %.1f s, replay stops there\n",
+                       path, cc->vend_us / 1e6);
+
+    cc->real0_us = metrics_now_us();
+    return 0;
+}
+
+int clock_client_record(struct clock_client *cc, const char *path) {
+    if (trace_create(&cc->rec, path) != 0) return -1;
+    cc->recording = 1;
+    return 0;
+}
+
+/* apply every record that is due at the current virtual time */
+static void cc_replay_catch_up(struct clock_client *cc) {
+    while (!cc->rp_eof) {
+        if (!cc->rp_has_ev) {
+            if (trace_next(&cc->rp, &cc->rp_ev) <= 0) { cc->rp_eof = 1; break; }
+            cc->rp_has_ev = 1;
+        }
+        if (cc->rp_ev.t_us > cc->vnow_us) break;
+
+        switch (cc->rp_ev.type) {
+        case TRACE_READ:
+        case TRACE_SAME:
+            memcpy(cc->line, cc->rp_ev.data, cc->rp_ev.len + 1);
+            cc->has_line = 1;
+            cc->rp_fail = 0;
+            break;
+        case TRACE_FAIL:
+            cc->rp_fail = 1;
+            break;
+        default:
+            break;
+        }
+        cc->rp_has_ev = 0;
+    }
+}
+
+/* time of the next record that changes what a read returns, -1 if none */
+static long long cc_replay_next_change(const struct clock_client *cc) {
+    struct trace_reader scan = cc->rp;
+    struct trace_event ev;
+
+    if (cc->rp_has_ev && (cc->rp_ev.type == TRACE_READ || cc->rp_ev.type == TRACE_FAIL))
+        return cc->rp_ev.t_us;
+    if (cc->rp_eof) return -1;
+    while (trace_next(&scan, &ev) > 0)
+        if (ev.type == TRACE_READ || ev.type == TRACE_FAIL) return ev.t_us;
+    return -1;
+}
+
+/* move virtual time forward, sleeping for real unless running flat out */
+static void cc_replay_advance(struct clock_client *cc, long long target_us) {
+    if (target_us <= cc->vnow_us) return;
+
+    if (cc->speed > 0) {
+        long long due = cc->real0_us + (long long)(target_us / cc->speed);
+        long long wait = due - metrics_now_us();
+        if (wait > 0) {
+            struct timespec ts = { wait / 1000000LL, (wait % 1000000LL) * 1000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+    cc->vnow_us = target_us;
+}
+
+/*
+ * Drain everything the broker sent since the last call and keep the newest.
+ * Returns 1 while connected but no snapshot has arrived yet, 2 while the
+ * broker reports the driver as gone.
+ */
+static int cc_broker_read(struct clock_client *cc) {
+    char buf[CLOCK_LINE_MAX];
+
+    if (!cc->has_line) {
+        struct pollfd pfd = { cc->fd, POLLIN, 0 };
+        poll(&pfd, 1, CLOCK_BROKER_WAIT_MS);
+    }
+
+    for (;;) {
+        atomic_fetch_add(&cc->syscalls, 1);
+        ssize_t n = recv(cc->fd, buf, sizeof(buf)-1, MSG_DONTWAIT);
+        if (n > 0) {
+            memcpy(cc->line, buf, n);
+            cc->line[n] = 0;
+            cc->has_line = 1;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0 && errno == EINTR) continue;
+        return -1;
+    }
+    if (!cc->has_line) return 1;
+    return strcmp(cc->line, CLOCK_BROKER_NODEV) == 0 ? 2 : 0;
+}
+
+void clock_client_close(struct clock_client *cc) {
+    clock_client_flush(cc);
+    cc_drop(cc);
+    if (cc->recording) trace_finish(&cc->rec);
+    cc->recording = 0;
+    if (cc->replay) trace_close(&cc->rp);
+}
+
+static int cc_replay_read(struct clock_client *cc, char *out, size_t outsz) {
+    cc_replay_catch_up(cc);
+    if (cc->rp_fail || !cc->has_line) return -1;
+    snprintf(out, outsz, "%s", cc->line);
+    return 0;
+}
+
+static int cc_read_line(struct clock_client *cc, char *out, size_t outsz) {
+    if (cc_reopen(cc) != 0) return -1;
+
+    long long t0 = metrics_now_us();
+    ssize_t n;
+
+    if (cc->broker) {
+        int r = cc_broker_read(cc);
+        if (r == 2) atomic_fetch_add(&cc->errors, 1);
+        if (r > 0) return -1;
+        if (r < 0) {
+            atomic_fetch_add(&cc->errors, 1);
+            cc_drop(cc);
+            return -1;
+        }
+        n = snprintf(out, outsz, "%s", cc->line);
+        if (n >= (ssize_t)outsz) n = outsz - 1;
+    } else {
+        /* the driver returns EOF once *ppos > 0, so always read from offset 0 */
+        atomic_fetch_add(&cc->syscalls, 1);
+        n = pread(cc->fd, out, outsz-1, 0);
+    }
+    metrics_hist_observe(&cc->read_us, (unsigned long)(metrics_now_us() - t0));
+    if (n <= 0) {
+        atomic_fetch_add(&cc->errors, 1);
+        cc_drop(cc);
+        return -1;
+    }
+    out[n] = 0;
+    return 0;
+}
+
+int clock_client_read_line(struct clock_client *cc, char *out, size_t outsz) {
+    if (cc->replay) return cc_replay_read(cc, out, outsz);
+
+    int r = cc_read_line(cc, out, outsz);
+    if (cc->recording) {
+        if (r == 0) trace_put_read(&cc->rec, metrics_now_us(), out, strlen(out));
+        else        trace_put_fail(&cc->rec, metrics_now_us());
+    }
+    return r;
+}
+
+void clock_status_init(struct clock_status *st) {
+    st->hh = st->mm = st->ss = 0;
+    strcpy(st->mode, "RUN");
+    strcpy(st->field, "SEC");
+    st->page = 0;
+    st->temp = -1;
+    st->hum = -1;
+    st->win = 0;
+}
+
+int clock_status_parse(const char *line, struct clock_status *st) {
+    int n = sscanf(line, "%d:%d:%d MODE=%7s FIELD=%7s PAGE=%d TEMP=%d HUM=%d WIN=%d",
+                   &st->hh, &st->mm, &st->ss, st->mode, st->field,
+                   &st->page, &st->temp, &st->hum, &st->win);
+    return (n >= 8) ? 0 : -1;
+}
+
+int clock_client_read(struct clock_client *cc, struct clock_status *st) {
+    char line[CLOCK_LINE_MAX];
+
+    clock_status_init(st);
+    if (clock_client_read_line(cc, line, sizeof(line)) != 0) return -1;
+    clock_status_parse(line, st);
+
+    cc->last = *st;
+    cc->has_last = 1;
+    return 0;
+}
+
+/*
+ * Returns 1 when there is something new to read, 0 on timeout.  Drivers
+ * built without poll support always look readable, so callers must not rely
+ * on this alone to pace a loop.
+ */
+int clock_client_wait(struct clock_client *cc, int timeout_ms) {
+    if (timeout_ms < 0) timeout_ms = 0;
+    if (cc->replay) {
+        long long target = cc->vnow_us + timeout_ms * 1000LL;
+        long long next = cc_replay_next_change(cc);
+        int woke = (next >= 0 && next <= target);
+
+        if (woke) target = next;
+        /* stop exactly on the last record once, then run past it */
+        if (cc->vnow_us < cc->vend_us && target > cc->vend_us) target = cc->vend_us;
+        cc_replay_advance(cc, target);
+        return woke;
+    }
+    if (cc->fd < 0) {
+        usleep((useconds_t)timeout_ms * 1000);
+        return 0;
+    }
+
+    struct pollfd pfd = { cc->fd, POLLIN, 0 };
+    atomic_fetch_add(&cc->syscalls, 1);
+    int r = poll(&pfd, 1, timeout_ms);
+    if (r < 0) return (errno == EINTR) ? 1 : -1;
+    return r > 0;
+}
+
+void clock_client_sleep(struct clock_client *cc, int ms) {
+    if (ms < 0) ms = 0;
+    if (cc->replay) cc_replay_advance(cc, cc->vnow_us + ms * 1000LL);
+    else            usleep((useconds_t)ms * 1000);
+}
+
+long long clock_client_now_ms(const struct clock_client *cc) {
+    if (cc->replay) return (cc->rp.hdr.mono_us + cc->vnow_us) / 1000;
+    return metrics_now_us() / 1000;
+}
+
+time_t clock_client_time(const struct clock_client *cc) {
+    if (cc->replay) return (time_t)((cc->rp.hdr.wall_us + cc->vnow_us) / 1000000LL);
+    return time(NULL);
+}
+
+int clock_client_done(const struct clock_client *cc) {
+    return cc->replay && cc->vnow_us > cc->vend_us;
+}
+
+void clock_client_set_led(struct clock_client *cc, int level) {
+    if (level < 0) level = 0;
+    if (level > 8) level = 8;
+
+    if (level == cc->led_level) cc->pending_led = -1;
+    else cc->pending_led = level;
+}
+
+void clock_client_set_time(struct clock_client *cc, int hh, int mm, int ss) {
+    /* nothing to do if the RTC already shows this time */
+    if (cc->has_last && strcmp(cc->last.mode, "RUN") == 0 &&
+        cc->last.hh == hh && cc->last.mm == mm && cc->last.ss == ss) {
+        cc->pending_set = 0;
+        return;
+    }
+    cc->set_hh = hh;
+    cc->set_mm = mm;
+    cc->set_ss = ss;
+    cc->pending_set = 1;
+}
+
+void clock_client_set_page(struct clock_client *cc, int page) {
+    if (page < 0 || page >= CLOCK_PAGES) return;
+    if (cc->has_last && cc->last.page == page) cc->pending_page = -1;
+    else cc->pending_page = page;
+}
+
+int clock_client_flush(struct clock_client *cc) {
+    char buf[64];
+    int len = 0;
+
+    if (cc->pending_led < 0 && !cc->pending_set && cc->pending_page < 0) return 0;
+
+    /* nothing to drive while replaying; act as if the write went through */
+    if (cc->replay) {
+        if (cc->pending_led >= 0) cc->led_level = cc->pending_led;
+        cc->pending_led = -1;
+        cc->pending_set = 0;
+        cc->pending_page = -1;
+        return 0;
+    }
+    if (cc_reopen(cc) != 0) return -1;
+
+    if (cc->pending_led >= 0)
+        len += snprintf(buf+len, sizeof(buf)-len, "LED %d\n", cc->pending_led);
+    if (cc->pending_set)
+        len += snprintf(buf+len, sizeof(buf)-len, "SET %02d:%02d:%02d\n",
+                        cc->set_hh, cc->set_mm, cc->set_ss);
+    if (cc->pending_page >= 0)
+        len += snprintf(buf+len, sizeof(buf)-len, "PAGE %d\n", cc->pending_page);
+
+    /* the driver and the broker take one command per line; a broker that
+     * went away must come back as an error here, not as SIGPIPE */
+    atomic_fetch_add(&cc->syscalls, 1);
+    ssize_t n = cc->broker ? send(cc->fd, buf, len, MSG_NOSIGNAL) : write(cc->fd, buf, len);
+    if (n != len) {
+        int rejected = (n < 0 && errno == EINVAL && !cc->broker);
+
+        atomic_fetch_add(&cc->errors, 1);
+        if (!rejected) {
+            cc_drop(cc);
+            return -1;
+        }
+        /* the driver ran the lines it understood and refused the rest;
+         * sending the same batch again cannot help, so let it go */
+        cc->led_level = -1;
+        cc->pending_led = -1;
+        cc->pending_set = 0;
+        cc->pending_page = -1;
+        return -1;
+    }
+
+    if (cc->recording) trace_put_write(&cc->rec, metrics_now_us(), buf, len);
+
+    if (cc->pending_led >= 0) cc->led_level = cc->pending_led;
+    cc->pending_led = -1;
+    cc->pending_set = 0;
+    cc->pending_page = -1;
+    return 0;
+}
@@ -0,0 +1,109 @@
+#ifndef CLOCK_CLIENT_H
+#define CLOCK_CLIENT_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "metrics.h"
+#include "trace.h"
+
+#define CLOCK_DEV "/dev/clock_drv"
+#define CLOCK_BROKER_SOCK "/run/clock_drv.sock"
+#define CLOCK_LINE_MAX TRACE_LINE_MAX
+#define CLOCK_PAGES 5               /* UI_PAGES in the driver; PAGE n takes 0..CLOCK_PAGES-1 */
+
+/* what brokerd publishes in place of a status line while the driver is unreadable */
+#define CLOCK_BROKER_NODEV "NODEV\n"
+
+struct clock_status {
+    int hh, mm, ss;
+    char mode[8];
+    char field[8];
+    int page;
+    int temp, hum;
+    int win;                /* graph window, 0 when the driver does not report it */
+};
+
+/*
+ * Keeps /dev/clock_drv open for the lifetime of the process and reads it with pread.
+ * LED / SET / PAGE commands are queued and sent in a single write by clock_client_flush();
+ * a command that would not change anything is dropped.
+ *
+ * Opened with clock_client_open_broker() the same interface talks to brokerd
+ * over a SOCK_SEQPACKET socket instead: status lines arrive only when they
+ * change and a read returns the newest one received.  While brokerd cannot
+ * read the driver it publishes CLOCK_BROKER_NODEV, and reads fail exactly
+ * as they would on the device.
+ *
+ * clock_client_record() additionally logs every read and every command
+ * written to a trace.  clock_client_open_replay() plays such a trace back
+ * with no device at all: time is virtual, advanced only by
+ * clock_client_wait() / clock_client_sleep(), and callers that take their
+ * time from clock_client_now_ms() / clock_client_time() behave the same
+ * on every run, at real time or as fast as the CPU allows.
+ */
+struct clock_client {
+    int fd;
+    const char *path;
+    int broker;
+
+    char line[CLOCK_LINE_MAX];      /* broker: newest status line */
+    int has_line;
+
+    int led_level;          /* last level written to the driver, -1 = unknown */
+    int pending_led;        /* -1 = none */
+
+    int set_hh, set_mm, set_ss;
+    int pending_set;
+
+    int pending_page;       /* -1 = none */
+
+    struct clock_status last;
+    int has_last;
+
+    atomic_ulong syscalls;
+    atomic_ulong errors;
+    struct metrics_hist read_us;
+
+    struct trace_writer rec;
+    int recording;
+
+    int replay;
+    struct trace_reader rp;
+    struct trace_event rp_ev;       /* next record, not yet due */
+    int rp_has_ev, rp_eof, rp_fail;
+    double speed;                   /* 1 = real time, 0 = as fast as possible */
+    long long vnow_us, vend_us;     /* virtual time and last record, from trace start */
+    long long real0_us;
+};
+
+int  clock_client_open(struct clock_client *cc, const char *path);
+int  clock_client_open_broker(struct clock_client *cc, const char *sock_path);
+int  clock_client_open_replay(struct clock_client *cc, const char *path, double speed);
+int  clock_client_record(struct clock_client *cc, const char *path);
+void clock_client_close(struct clock_client *cc);
+
+int  clock_client_read_line(struct clock_client *cc, char *out, size_t outsz);
+int  clock_client_read(struct clock_client *cc, struct clock_status *st);
+
+/* sleep until the driver (or broker) reports input, or timeout_ms passes */
+int  clock_client_wait(struct clock_client *cc, int timeout_ms);
+void clock_client_sleep(struct clock_client *cc, int ms);
+
+/* CLOCK_MONOTONIC ms and wall-clock seconds, virtual while replaying */
+long long clock_client_now_ms(const struct clock_client *cc);
+time_t    clock_client_time(const struct clock_client *cc);
+
+/* replay: the trace has been played to its end */
+int  clock_client_done(const struct clock_client *cc);
+
+void clock_client_set_led(struct clock_client *cc, int level);
+void clock_client_set_time(struct clock_client *cc, int hh, int mm, int ss);
+void clock_client_set_page(struct clock_client *cc, int page);
+int  clock_client_flush(struct clock_client *cc);
+
+void clock_status_init(struct clock_status *st);
+int  clock_status_parse(const char *line, struct clock_status *st);
+
+#endif
@@ -0,0 +1,110 @@
+#include <stdint.h>
+
+#include "di_engine.h"
+
+#define T_N (DI_T_MAX - DI_T_MIN + 1)
+#define H_N (DI_H_MAX - DI_H_MIN + 1)
+
+static int16_t di_table[T_N][H_N];
+static int di_table_ready;
+
+/*
+ * DI = 0.81T + 0.01H(0.99T - 14.3) + 46.3, scaled by 10000 it is all integer:
+ * 8100T + H(99T - 1430) + 463000.
+ */
+int di_x10_exact(int temp, int hum) {
+    int v = 8100*temp + hum*(99*temp - 1430) + 463000;
+    return v / 1000;            /* truncate like the original (int) cast */
+}
+
+static void di_table_init(void) {
+    if (di_table_ready) return;
+    for (int t = 0; t < T_N; t++)
+        for (int h = 0; h < H_N; h++)
+            di_table[t][h] = (int16_t)di_x10_exact(DI_T_MIN + t, DI_H_MIN + h);
+    di_table_ready = 1;
+}
+
+/* DI is bilinear in (T, H), so interpolating the table is exact up to rounding */
+static int di_lookup_q8(int t_q8, int h_q8) {
+    int t = t_q8 - DI_T_MIN*256, h = h_q8 - DI_H_MIN*256;
+    int ti = t >> 8, hi = h >> 8;
+    int tf = t & 0xFF, hf = h & 0xFF;
+
+    if (ti >= T_N - 1) { ti = T_N - 2; tf = 256; }
+    if (hi >= H_N - 1) { hi = H_N - 2; hf = 256; }
+
+    int v = di_table[ti][hi]     * (256-tf) * (256-hf)
+          + di_table[ti+1][hi]   * tf       * (256-hf)
+          + di_table[ti][hi+1]   * (256-tf) * hf
+          + di_table[ti+1][hi+1] * tf       * hf;
+    return (v + 32768) >> 16;
+}
+
+int di_level_for(int di_x10) {
+    int di = di_x10 / 10;
+    if (di < 65) return 0;
+    if (di > 80) return 8;
+    return 1 + (di - 65) * 7 / 15;
+}
+
+enum di_category di_category_for(int di_x10) {
+    int di = di_x10 / 10;
+    if (di < 68) return DI_GOOD;
+    if (di < 75) return DI_MILD;
+    if (di < 80) return DI_BAD;
+    return DI_HOT;
+}
+
+void di_engine_init(struct di_engine *e) {
+    di_table_init();
+    e->t_q8 = e->h_q8 = 0;
+    e->primed = 0;
+    e->di_x10 = -1;
+    e->level = 0;
+    e->cat = DI_NONE;
+}
+
+static int ema_q8(int s, int x) {
+    int d = x*256 - s;
+    if (d > -(1 << DI_EMA_SHIFT) && d < (1 << DI_EMA_SHIFT)) return x*256;
+    return s + d / (1 << DI_EMA_SHIFT);
+}
+
+int di_engine_update(struct di_engine *e, int temp, int hum) {
+    int changed = 0;
+
+    if (temp < DI_T_MIN || temp > DI_T_MAX || hum < DI_H_MIN || hum > DI_H_MAX)
+        return 0;
+
+    if (!e->primed) {
+        e->t_q8 = temp * 256;
+        e->h_q8 = hum * 256;
+        e->primed = 1;
+    } else {
+        e->t_q8 = ema_q8(e->t_q8, temp);
+        e->h_q8 = ema_q8(e->h_q8, hum);
+    }
+
+    int di = di_lookup_q8(e->t_q8, e->h_q8);
+    if (di != e->di_x10) changed |= DI_CHANGED_VALUE;
+    e->di_x10 = di;
+
+    /* only move off the current level / category once it is out of reach by the band */
+    int lo = di_level_for(di - DI_HYST_X10), hi = di_level_for(di + DI_HYST_X10);
+    if (e->cat == DI_NONE || e->level < lo || e->level > hi) {
+        int level = di_level_for(di);
+        if (level != e->level) changed |= DI_CHANGED_LEVEL;
+        e->level = level;
+    }
+
+    enum di_category clo = di_category_for(di - DI_HYST_X10);
+    enum di_category chi = di_category_for(di + DI_HYST_X10);
+    if (e->cat == DI_NONE || e->cat < clo || e->cat > chi) {
+        enum di_category cat = di_category_for(di);
+        if (cat != e->cat) changed |= DI_CHANGED_CATEGORY;
+        e->cat = cat;
+    }
+
+    return changed;
+}
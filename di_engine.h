@@ -0,0 +1,41 @@
+#ifndef DI_ENGINE_H
+#define DI_ENGINE_H
+
+/* DHT11 reporting range */
+#define DI_T_MIN 0
+#define DI_T_MAX 50
+#define DI_H_MIN 0
+#define DI_H_MAX 100
+
+#define DI_HYST_X10 5           /* 0.5 DI units around every level / category edge */
+#define DI_EMA_SHIFT 2          /* smoothing factor 1/4 per sample */
+
+enum di_category { DI_NONE, DI_GOOD, DI_MILD, DI_BAD, DI_HOT };
+
+#define DI_CHANGED_VALUE    0x1
+#define DI_CHANGED_LEVEL    0x2
+#define DI_CHANGED_CATEGORY 0x4
+
+struct di_engine {
+    int t_q8, h_q8;             /* smoothed inputs, 8 fractional bits */
+    int primed;
+
+    int di_x10;                 /* smoothed DI in tenths, -1 = no data */
+    int level;                  /* LED bar level 0..8 */
+    enum di_category cat;
+};
+
+void di_engine_init(struct di_engine *e);
+
+/* feed one sensor sample; returns DI_CHANGED_* bits */
+int  di_engine_update(struct di_engine *e, int temp, int hum);
+
+static inline int di_engine_value(const struct di_engine *e) {
+    return e->di_x10 < 0 ? -1 : e->di_x10 / 10;
+}
+
+int di_x10_exact(int temp, int hum);
+int di_level_for(int di_x10);
+enum di_category di_category_for(int di_x10);
+
+#endif
@@ -10,6 +10,8 @@
 #include <linux/cdev.h>
 #include <linux/device.h>
 #include <linux/uaccess.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
 #include <linux/rtc.h>
 #include <linux/time64.h>
 #include <linux/types.h>
@@ -49,6 +51,10 @@ static int leds[8] = {
 
 #define DHT_CACHE_MS     2000
 
+#define UI_PAGES         5
+#define GRAPH_PAGE_FIRST 3
+#define GRAPH_WINDOWS    3
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("kkk");
 MODULE_DESCRIPTION("DS1302 + rotary/button + DHT11 via /dev/clock_drv");
@@ -66,8 +72,13 @@ static bool edit_mode = false;
 static int edit_field = 2;
 
 static int ui_page = 0;
+static int graph_win = 0;
 static unsigned long last_page_switch_j = 0;
 
+/* bumped on every user-visible state change; poll() reports it to readers */
+static DECLARE_WAIT_QUEUE_HEAD(state_wq);
+static atomic_t state_gen = ATOMIC_INIT(1);
+
 static int irq_s1, irq_sw;
 static unsigned long last_irq_s1, last_irq_sw;
 static unsigned long sw_pressed_jiffies;
@@ -80,6 +91,8 @@ static int dht_temp = -1;
 static int dht_hum  = -1;
 static unsigned long last_dht_j = 0;
 
+static int led_level = -1;
+
 
 static inline void ds_clk_pulse(void)
 {
@@ -276,6 +289,10 @@ static void apply_delta_locked(int delta)
 
 static void short_press_locked(void)
 {
+    if (!edit_mode && ui_page >= GRAPH_PAGE_FIRST) {
+        graph_win = (graph_win + 1) % GRAPH_WINDOWS;
+        return;
+    }
     if (!edit_mode) return;
     if (ui_page != 0) return;
 
@@ -320,9 +337,9 @@ static void page_toggle_if_cw_locked(void)
 
     if (gpio_get_value(ENC_S2)) {
         
-        ui_page = (ui_page + 1) % 3;
+        ui_page = (ui_page + 1) % UI_PAGES;
     } else {
-        ui_page = (ui_page + 3 - 1) % 3;
+        ui_page = (ui_page + UI_PAGES - 1) % UI_PAGES;
     }
 
     last_page_switch_j = now;
@@ -330,6 +347,12 @@ static void page_toggle_if_cw_locked(void)
 
 
 
+static void state_changed(void)
+{
+    atomic_inc(&state_gen);
+    wake_up_interruptible(&state_wq);
+}
+
 static irqreturn_t s1_irq_handler(int irq, void *dev_id)
 {
     unsigned long now = jiffies;
@@ -350,6 +373,7 @@ static irqreturn_t s1_irq_handler(int irq, void *dev_id)
     }
 
     mutex_unlock(&lock0);
+    state_changed();
     return IRQ_HANDLED;
 }
 
@@ -372,6 +396,7 @@ static irqreturn_t sw_irq_handler(int irq, void *dev_id)
             short_press_locked();
             mutex_unlock(&lock0);
         }
+        state_changed();
     }
 
     return IRQ_HANDLED;
@@ -383,6 +408,8 @@ static void set_led_level(int level)
 
     if (level < 0) level = 0;
     if (level > 8) level = 8;
+    if (level == led_level) return;
+    led_level = level;
 
     for (i = 0; i < 8; i++) {
         gpio_set_value(leds[i], (i < level) ? 1 : 0);
@@ -396,29 +423,33 @@ static ssize_t dev_read(struct file *f, char __user *ubuf, size_t cnt, loff_t *p
     int len;
     struct rtc_simple t;
     bool mode;
-    int field, page;
+    int field, page, win;
     int temp, hum;
 
     if (*ppos > 0) return 0;
 
+    /* this reader has now seen everything up to the current generation */
+    f->private_data = (void *)(unsigned long)atomic_read(&state_gen);
+
     ds1302_read_time(&cur);
 
     mutex_lock(&lock0);
     mode  = edit_mode;
     field = edit_field;
     page  = ui_page;
+    win   = graph_win;
     t     = (mode && page==0) ? edit : cur;
     mutex_unlock(&lock0);
 
     dht11_get_cached(&temp, &hum);
 
     len = snprintf(kbuf, sizeof(kbuf),
-                   "%02d:%02d:%02d MODE=%s FIELD=%s PAGE=%d TEMP=%d HUM=%d\n",
+                   "%02d:%02d:%02d MODE=%s FIELD=%s PAGE=%d TEMP=%d HUM=%d WIN=%d\n",
                    t.hh, t.mm, t.ss,
                    (mode && page==0) ? "EDIT" : "RUN",
                    field_name(field),
                    page,
-                   temp, hum);
+                   temp, hum, win);
 
     if (len > cnt) len = cnt;
     if (copy_to_user(ubuf, kbuf, len)) return -EFAULT;
@@ -427,29 +458,29 @@ static ssize_t dev_read(struct file *f, char __user *ubuf, size_t cnt, loff_t *p
     return len;
 }
 
-static ssize_t dev_write(struct file *f, const char __user *ubuf,
-                         size_t cnt, loff_t *ppos)
+static int exec_cmd_line(char *line)
 {
-    char kbuf[64];
     int hh, mm, ss;
     int level;
+    int page;
 
-    if (cnt >= sizeof(kbuf))
-        return -EINVAL;
-
-    if (copy_from_user(kbuf, ubuf, cnt))
-        return -EFAULT;
-
-    kbuf[cnt] = '\0';   
-
-    
-    if (sscanf(kbuf, "LED %d", &level) == 1) {
+    if (sscanf(line, "LED %d", &level) == 1) {
         set_led_level(level);
-        return cnt;
+        return 0;
     }
 
+    /* lets the UI undo the encoder step that only woke a dark panel */
+    if (sscanf(line, "PAGE %d", &page) == 1) {
+        if (page < 0 || page >= UI_PAGES) return -EINVAL;
+        mutex_lock(&lock0);
+        if (!edit_mode) ui_page = page;
+        mutex_unlock(&lock0);
+        state_changed();
+        return 0;
+    }
 
-    if (sscanf(kbuf, "SET %d:%d:%d", &hh, &mm, &ss) == 3) {
+
+    if (sscanf(line, "SET %d:%d:%d", &hh, &mm, &ss) == 3) {
         struct rtc_simple t = {
             .hh = hh,
             .mm = mm,
@@ -463,17 +494,60 @@ static ssize_t dev_write(struct file *f, const char __user *ubuf,
         mutex_lock(&lock0);
         edit_mode = false;
         mutex_unlock(&lock0);
+        state_changed();
 
-        return cnt;
+        return 0;
     }
 
     return -EINVAL;
 }
 
+static ssize_t dev_write(struct file *f, const char __user *ubuf,
+                         size_t cnt, loff_t *ppos)
+{
+    char kbuf[128];
+    char *p, *line;
+    int ret = 0;
+
+    if (cnt >= sizeof(kbuf))
+        return -EINVAL;
+
+    if (copy_from_user(kbuf, ubuf, cnt))
+        return -EFAULT;
+
+    kbuf[cnt] = '\0';   
+
+    /* one command per line, so a client can batch "LED n\nSET hh:mm:ss\n" */
+    p = kbuf;
+    while ((line = strsep(&p, "\n")) != NULL) {
+        if (line[0] == '\0')
+            continue;
+        if (exec_cmd_line(line) < 0)
+            ret = -EINVAL;
+    }
+
+    return ret ? ret : cnt;
+}
+
+/*
+ * Readable once the encoder, button, a SET or a PAGE changed something since this
+ * file last read.  The clock ticking on its own does not wake pollers.
+ */
+static __poll_t dev_poll(struct file *f, poll_table *wait)
+{
+    unsigned long seen = (unsigned long)f->private_data;
+
+    poll_wait(f, &state_wq, wait);
+    if ((unsigned long)atomic_read(&state_gen) != seen)
+        return EPOLLIN | EPOLLRDNORM;
+    return 0;
+}
+
 static const struct file_operations fops = {
     .owner = THIS_MODULE,
     .read  = dev_read,
     .write = dev_write,
+    .poll  = dev_poll,
 };
 
 static int __init mod_init(void)
@@ -0,0 +1,97 @@
+#include <string.h>
+
+#include "graph.h"
+#include "raster.h"
+
+void graph_init(struct graph *g, enum graph_field field, int page0, int pages) {
+    memset(g, 0, sizeof(*g));
+    g->field = field;
+    g->page0 = page0;
+    g->pages = pages > GRAPH_MAX_PAGES ? GRAPH_MAX_PAGES : pages;
+    g->tier = -1;
+    g->last_y = -1;
+}
+
+static int point_value(const struct graph *g, const struct hist_point *p) {
+    if (g->field == GRAPH_TEMP) return p->t_x10;
+    if (g->field == GRAPH_HUM)  return p->h_x10;
+    return p->di_x10;
+}
+
+static int value_y(const struct graph *g, int v) {
+    int h = g->pages * 8;
+    return (h - 1) - (v - g->lo) * (h - 1) / (g->hi - g->lo);
+}
+
+static void shift_left(struct graph *g) {
+    for (int p = 0; p < g->pages; p++) {
+        memmove(g->buf[p], g->buf[p] + 1, OLED_W - 1);
+        g->buf[p][OLED_W - 1] = 0;
+    }
+}
+
+static void draw_point(struct graph *g, int x, const struct hist_point *p, int ok) {
+    if (!ok) { g->last_y = -1; return; }
+
+    int y = value_y(g, point_value(g, p));
+    /* buf has the frame's OLED_W stride; y stays inside its pages since lo..hi bound v */
+    raster_vspan(g->buf[0], x, g->last_y < 0 ? y : g->last_y, y, RASTER_SET);
+    g->last_y = y;
+}
+
+static void replot(struct graph *g, const struct history *h, enum hist_tier tier) {
+    struct hist_point p;
+    int lo = 0, hi = 0, n = 0;
+
+    memset(g->buf, 0, sizeof(g->buf));
+    g->tier = tier;
+    g->seq = history_seq(h, tier);
+    g->last_y = -1;
+
+    for (int back = 0; back < OLED_W; back++) {
+        if (history_get(h, tier, back, &p) != 0) continue;
+        int v = point_value(g, &p);
+        if (n == 0 || v < lo) lo = v;
+        if (n == 0 || v > hi) hi = v;
+        n++;
+    }
+    if (n == 0) return;
+
+    /* at least 2.0 units of range, with a margin so small moves stay in scale */
+    int pad = (hi - lo) / 4;
+    if (pad < 10) pad = 10;
+    g->lo = lo - pad;
+    g->hi = hi + pad;
+
+    for (int back = OLED_W - 1; back >= 0; back--) {
+        int ok = (history_get(h, tier, back, &p) == 0);
+        draw_point(g, OLED_W - 1 - back, &p, ok);
+    }
+}
+
+void graph_update(struct graph *g, const struct history *h, enum hist_tier tier) {
+    uint32_t seq = history_seq(h, tier);
+    struct hist_point p;
+
+    if (g->tier != (int)tier || g->hi == g->lo || seq - g->seq >= OLED_W) {
+        replot(g, h, tier);
+        return;
+    }
+
+    while (g->seq != seq) {
+        uint32_t back = seq - g->seq - 1;
+        int ok = (history_get(h, tier, back, &p) == 0);
+
+        if (ok) {
+            int v = point_value(g, &p);
+            if (v < g->lo || v > g->hi) { replot(g, h, tier); return; }
+        }
+        shift_left(g);
+        draw_point(g, OLED_W - 1, &p, ok);
+        g->seq++;
+    }
+}
+
+void graph_blit(const struct graph *g, uint8_t *fb) {
+    memcpy(fb + g->page0 * OLED_W, g->buf, (size_t)g->pages * OLED_W);
+}
@@ -0,0 +1,35 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stdint.h>
+
+#include "oled.h"
+#include "history.h"
+
+#define GRAPH_MAX_PAGES 6
+
+enum graph_field { GRAPH_TEMP, GRAPH_HUM, GRAPH_DI };
+
+/*
+ * Sparkline over one history tier, kept in its own page-layout buffer
+ * between frames.  A new sample shifts the buffer one column left and
+ * draws only the new column; the series is replotted only when the tier
+ * changes or a value leaves the current scale.
+ */
+struct graph {
+    enum graph_field field;
+    int page0, pages;           /* fb page rows covered */
+
+    uint8_t buf[GRAPH_MAX_PAGES][OLED_W];
+
+    int tier;                   /* -1 = nothing plotted yet */
+    uint32_t seq;               /* newest history seq drawn */
+    int lo, hi;                 /* scale, x10 units */
+    int last_y;                 /* y of the previous column, -1 = gap */
+};
+
+void graph_init(struct graph *g, enum graph_field field, int page0, int pages);
+void graph_update(struct graph *g, const struct history *h, enum hist_tier tier);
+void graph_blit(const struct graph *g, uint8_t *fb);
+
+#endif
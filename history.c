@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "history.h"
+
+_Static_assert(sizeof(struct hist_rec) == 16, "hist_rec layout");
+_Static_assert(sizeof(struct hist_rollup) == 32, "hist_rollup layout");
+_Static_assert(sizeof(struct hist_header) <= 4096, "hist_header layout");
+
+#define HIST_HDR_SIZE 4096
+
+static const uint32_t bucket_len[HIST_TIERS] = { 0, 60, 3600 };
+
+static uint16_t crc16(const uint8_t *p, size_t n) {
+    uint16_t crc = 0xFFFF;
+    while (n--) {
+        crc ^= (uint16_t)*p++ << 8;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static uint8_t *slot_ptr(const struct history *h, const struct hist_ring *r, uint32_t slot) {
+    return h->map + r->off + (size_t)slot * r->rec_size;
+}
+
+static uint32_t rec_seq(const uint8_t *p) {
+    uint32_t seq;
+    memcpy(&seq, p, sizeof(seq));
+    return seq;
+}
+
+static int rec_valid(const struct hist_ring *r, const uint8_t *p) {
+    uint16_t crc;
+    memcpy(&crc, p + r->rec_size - 2, sizeof(crc));
+    return rec_seq(p) != 0 && crc == crc16(p, r->rec_size - 2);
+}
+
+static void ring_scan(struct history *h, struct hist_ring *r) {
+    r->seq = 0;
+    r->head = 0;
+    for (uint32_t i = 0; i < r->cap; i++) {
+        const uint8_t *p = slot_ptr(h, r, i);
+        if (rec_valid(r, p) && rec_seq(p) > r->seq) {
+            r->seq = rec_seq(p);
+            r->head = (i + 1) % r->cap;
+        }
+    }
+}
+
+/* newest-first lookup over staged and committed records */
+static const uint8_t *ring_get(const struct history *h, const struct hist_ring *r, uint32_t back) {
+    if (back < (uint32_t)r->npend) return r->pend[r->npend - 1 - back];
+
+    back -= r->npend;
+    if (back >= r->cap || back >= r->seq) return NULL;
+
+    const uint8_t *p = slot_ptr(h, r, (r->head + r->cap - 1 - back) % r->cap);
+    if (!rec_valid(r, p) || rec_seq(p) != r->seq - back) return NULL;
+    return p;
+}
+
+static void ring_push(struct history *h, struct hist_ring *r, void *rec) {
+    uint8_t *p;
+    uint32_t seq;
+    uint16_t crc;
+
+    if (r->npend == HIST_PENDING) history_commit(h);
+
+    p = r->pend[r->npend++];
+    memcpy(p, rec, r->rec_size);
+    seq = r->seq + r->npend;
+    memcpy(p, &seq, sizeof(seq));
+    crc = crc16(p, r->rec_size - 2);
+    memcpy(p + r->rec_size - 2, &crc, sizeof(crc));
+}
+
+int history_commit(struct history *h) {
+    int dirty = 0;
+
+    for (int t = 0; t < HIST_TIERS; t++) {
+        struct hist_ring *r = &h->ring[t];
+        for (int i = 0; i < r->npend; i++) {
+            memcpy(slot_ptr(h, r, r->head), r->pend[i], r->rec_size);
+            r->head = (r->head + 1) % r->cap;
+            r->seq++;
+        }
+        dirty |= r->npend;
+        r->npend = 0;
+    }
+    if (!dirty) return 0;
+
+    /* only the pages touched since the last commit are written back */
+    if (msync(h->map, h->size, MS_SYNC) != 0) { perror("msync history"); return -1; }
+    return 0;
+}
+
+
+static void acc_reset(struct hist_acc *a, uint32_t bucket) {
+    memset(a, 0, sizeof(*a));
+    a->bucket = bucket;
+}
+
+static void acc_add(struct hist_acc *a, const struct hist_rollup *v) {
+    if (a->n == 0) {
+        a->t_min = v->t_min;  a->t_max = v->t_max;
+        a->h_min = v->h_min;  a->h_max = v->h_max;
+        a->di_min = v->di_min; a->di_max = v->di_max;
+    } else {
+        if (v->t_min < a->t_min) a->t_min = v->t_min;
+        if (v->t_max > a->t_max) a->t_max = v->t_max;
+        if (v->h_min < a->h_min) a->h_min = v->h_min;
+        if (v->h_max > a->h_max) a->h_max = v->h_max;
+        if (v->di_min < a->di_min) a->di_min = v->di_min;
+        if (v->di_max > a->di_max) a->di_max = v->di_max;
+    }
+    a->n += v->count;
+    a->t_sum  += (long)v->t_avg_x10 * v->count;
+    a->h_sum  += (long)v->h_avg_x10 * v->count;
+    a->di_sum += (long)v->di_avg * v->count;
+}
+
+static void acc_to_rollup(const struct hist_acc *a, struct hist_rollup *out) {
+    memset(out, 0, sizeof(*out));
+    out->ts = a->bucket;
+    out->count = (uint16_t)(a->n > 0xFFFF ? 0xFFFF : a->n);
+    out->t_min = (int8_t)a->t_min;   out->t_max = (int8_t)a->t_max;
+    out->h_min = (uint8_t)a->h_min;  out->h_max = (uint8_t)a->h_max;
+    out->di_min = (uint16_t)a->di_min; out->di_max = (uint16_t)a->di_max;
+    out->t_avg_x10 = (int16_t)(a->t_sum / (long)a->n);
+    out->h_avg_x10 = (uint16_t)(a->h_sum / (long)a->n);
+    out->di_avg    = (uint16_t)(a->di_sum / (long)a->n);
+}
+
+static void feed_tier(struct history *h, enum hist_tier tier, const struct hist_rollup *v) {
+    struct hist_acc *a = (tier == HIST_MIN) ? &h->acc_min : &h->acc_hour;
+    uint32_t bucket = v->ts - v->ts % bucket_len[tier];
+
+    if (a->n && bucket != a->bucket) {
+        struct hist_rollup out;
+        acc_to_rollup(a, &out);
+        ring_push(h, &h->ring[tier], &out);
+        if (tier == HIST_MIN) feed_tier(h, HIST_HOUR, &out);
+    }
+    if (a->n == 0 || bucket != a->bucket) acc_reset(a, bucket);
+    acc_add(a, v);
+}
+
+static void feed_raw(struct history *h, const struct hist_rec *r) {
+    struct hist_rollup v;
+
+    if (r->status != HIST_OK) return;
+
+    memset(&v, 0, sizeof(v));
+    v.ts = r->ts;
+    v.count = 1;
+    v.t_min = v.t_max = r->temp;
+    v.h_min = v.h_max = r->hum;
+    v.di_min = v.di_max = v.di_avg = r->di_x10;
+    v.t_avg_x10 = r->temp * 10;
+    v.h_avg_x10 = r->hum * 10;
+    feed_tier(h, HIST_MIN, &v);
+}
+
+/*
+ * Rebuild the open minute / hour buckets after a restart: minute rollups
+ * newer than the last hour rollup go back into the hour accumulator, raw
+ * samples newer than the last minute rollup go back into the minute one.
+ * Rollups that were lost with the power are re-emitted on the way.
+ */
+static uint32_t count_since(const struct history *h, enum hist_tier tier, uint32_t since) {
+    uint32_t n = 0;
+    const uint8_t *p;
+
+    while ((p = ring_get(h, &h->ring[tier], n)) != NULL) {
+        uint32_t ts;
+        memcpy(&ts, p + 4, sizeof(ts));
+        if (ts < since) break;
+        n++;
+    }
+    return n;
+}
+
+static uint32_t tier_end(const struct history *h, enum hist_tier tier) {
+    struct hist_rollup last;
+    const uint8_t *p = ring_get(h, &h->ring[tier], 0);
+
+    if (!p) return 0;
+    memcpy(&last, p, sizeof(last));
+    return last.ts + bucket_len[tier];
+}
+
+static void history_rebuild(struct history *h) {
+    uint32_t hour_end = tier_end(h, HIST_HOUR);
+    uint32_t min_end  = tier_end(h, HIST_MIN);
+    uint32_t n;
+
+    acc_reset(&h->acc_min, 0);
+    acc_reset(&h->acc_hour, 0);
+
+    n = count_since(h, HIST_MIN, hour_end);
+    while (n-- > 0) {
+        struct hist_rollup v;
+        memcpy(&v, ring_get(h, &h->ring[HIST_MIN], n), sizeof(v));
+        feed_tier(h, HIST_HOUR, &v);
+    }
+
+    n = count_since(h, HIST_RAW, min_end);
+    while (n-- > 0) {
+        struct hist_rec r;
+        memcpy(&r, ring_get(h, &h->ring[HIST_RAW], n), sizeof(r));
+        feed_raw(h, &r);
+    }
+}
+
+
+static size_t layout(uint32_t cap[HIST_TIERS], uint32_t off[HIST_TIERS]) {
+    size_t pos = HIST_HDR_SIZE;
+    long pg = sysconf(_SC_PAGESIZE);
+
+    off[HIST_RAW] = pos;  pos += (size_t)cap[HIST_RAW]  * sizeof(struct hist_rec);
+    off[HIST_MIN] = pos;  pos += (size_t)cap[HIST_MIN]  * sizeof(struct hist_rollup);
+    off[HIST_HOUR] = pos; pos += (size_t)cap[HIST_HOUR] * sizeof(struct hist_rollup);
+    return (pos + pg - 1) / pg * pg;
+}
+
+int history_open(struct history *h, const char *path,
+                 uint32_t raw_cap, uint32_t min_cap, uint32_t hour_cap) {
+    struct hist_header hdr;
+    struct stat stt;
+    uint32_t cap[HIST_TIERS] = { raw_cap, min_cap, hour_cap };
+    uint32_t off[HIST_TIERS];
+    int fresh = 0;
+
+    memset(h, 0, sizeof(*h));
+    h->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (h->fd < 0) { perror(path); return -1; }
+    if (fstat(h->fd, &stt) != 0) { perror(path); goto fail; }
+
+    if (stt.st_size >= HIST_HDR_SIZE &&
+        pread(h->fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) &&
+        hdr.magic == HIST_MAGIC && hdr.version == HIST_VERSION) {
+        if (memcmp(hdr.cap, cap, sizeof(cap)) != 0)
+            fprintf(stderr, "history: %s keeps its existing ring sizes %u/%u/%u\n",
+                    path, hdr.cap[0], hdr.cap[1], hdr.cap[2]);
+        memcpy(cap, hdr.cap, sizeof(cap));
+    } else if (stt.st_size == 0) {
+        fresh = 1;
+    } else {
+        fprintf(stderr, "history: %s is not a history file\n", path);
+        goto fail;
+    }
+
+    for (int t = 0; t < HIST_TIERS; t++)
+        if (cap[t] == 0) { fprintf(stderr, "history: empty ring\n"); goto fail; }
+
+    h->size = layout(cap, off);
+    if (fresh) {
+        if (posix_fallocate(h->fd, 0, h->size) != 0) {
+            perror(path);
+            goto fail;
+        }
+    } else if ((size_t)stt.st_size < h->size) {
+        fprintf(stderr, "history: %s is truncated\n", path);
+        goto fail;
+    }
+
+    h->map = mmap(NULL, h->size, PROT_READ | PROT_WRITE, MAP_SHARED, h->fd, 0);
+    if (h->map == MAP_FAILED) { perror("mmap history"); h->map = NULL; goto fail; }
+
+    if (fresh) {
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.magic = HIST_MAGIC;
+        hdr.version = HIST_VERSION;
+        memcpy(hdr.cap, cap, sizeof(cap));
+        memcpy(hdr.off, off, sizeof(off));
+        memcpy(h->map, &hdr, sizeof(hdr));
+        msync(h->map, HIST_HDR_SIZE, MS_SYNC);
+    }
+
+    for (int t = 0; t < HIST_TIERS; t++) {
+        h->ring[t].off = off[t];
+        h->ring[t].cap = cap[t];
+        h->ring[t].rec_size = (t == HIST_RAW) ? sizeof(struct hist_rec) : sizeof(struct hist_rollup);
+        ring_scan(h, &h->ring[t]);
+    }
+
+    history_rebuild(h);
+    return 0;
+
+fail:
+    close(h->fd);
+    h->fd = -1;
+    return -1;
+}
+
+void history_close(struct history *h) {
+    if (h->map) {
+        history_commit(h);
+        munmap(h->map, h->size);
+    }
+    if (h->fd >= 0) close(h->fd);
+    h->map = NULL;
+    h->fd = -1;
+}
+
+int history_append(struct history *h, uint32_t ts, int temp, int hum, int di_x10, int status) {
+    struct hist_rec r;
+
+    memset(&r, 0, sizeof(r));
+    r.ts = ts;
+    r.status = (uint8_t)status;
+    if (status == HIST_OK) {
+        r.temp = (int8_t)temp;
+        r.hum = (uint8_t)hum;
+        r.di_x10 = (uint16_t)(di_x10 < 0 ? 0 : di_x10);
+    }
+    ring_push(h, &h->ring[HIST_RAW], &r);
+    feed_raw(h, &r);
+
+    if (h->last_commit == 0) h->last_commit = ts;
+    if (ts - h->last_commit >= HIST_COMMIT_S) {
+        h->last_commit = ts;
+        return history_commit(h);
+    }
+    return 0;
+}
+
+uint32_t history_seq(const struct history *h, enum hist_tier tier) {
+    return h->ring[tier].seq + h->ring[tier].npend;
+}
+
+int history_get(const struct history *h, enum hist_tier tier, uint32_t back, struct hist_point *p) {
+    const uint8_t *raw = ring_get(h, &h->ring[tier], back);
+    if (!raw) return -1;
+
+    if (tier == HIST_RAW) {
+        struct hist_rec r;
+        memcpy(&r, raw, sizeof(r));
+        if (r.status != HIST_OK) return -1;
+        p->ts = r.ts;
+        p->t_x10 = r.temp * 10;  p->t_min = p->t_max = r.temp;
+        p->h_x10 = r.hum * 10;   p->h_min = p->h_max = r.hum;
+        p->di_x10 = p->di_min = p->di_max = r.di_x10;
+    } else {
+        struct hist_rollup v;
+        memcpy(&v, raw, sizeof(v));
+        p->ts = v.ts;
+        p->t_x10 = v.t_avg_x10;  p->t_min = v.t_min;  p->t_max = v.t_max;
+        p->h_x10 = v.h_avg_x10;  p->h_min = v.h_min;  p->h_max = v.h_max;
+        p->di_x10 = v.di_avg;    p->di_min = v.di_min; p->di_max = v.di_max;
+    }
+    return 0;
+}
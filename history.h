@@ -0,0 +1,109 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+
+/*
+ * Append-only sensor history in a memory-mapped file.
+ *
+ * Three fixed-size rings live in one file: raw samples, per-minute and
+ * per-hour min/max/avg rollups.  No head pointer is stored; every record
+ * carries a sequence number and a CRC and the newest valid record is found
+ * by scanning on open, so a torn write only loses that record.
+ *
+ * New records are staged in memory and copied into the mapping only on
+ * commit, followed by msync, so the card sees at most a few page writes
+ * per commit interval no matter how often samples arrive.
+ */
+
+#define HIST_MAGIC   0x54534944u        /* "DIST" */
+#define HIST_VERSION 1
+
+#define HIST_RAW_CAP_DEFAULT   17280    /* 2 days at 10 s */
+#define HIST_MIN_CAP_DEFAULT   40320    /* 28 days */
+#define HIST_HOUR_CAP_DEFAULT  8784     /* 1 year */
+
+#define HIST_SAMPLE_MS   10000
+#define HIST_COMMIT_S    300
+#define HIST_PENDING     64
+
+enum hist_status { HIST_OK, HIST_NO_DATA, HIST_NO_DEVICE };
+enum hist_tier   { HIST_RAW, HIST_MIN, HIST_HOUR, HIST_TIERS };
+
+struct hist_rec {
+    uint32_t seq;
+    uint32_t ts;
+    int8_t   temp;
+    uint8_t  hum;
+    uint16_t di_x10;
+    uint8_t  status;
+    uint8_t  pad;
+    uint16_t crc;
+};
+
+struct hist_rollup {
+    uint32_t seq;
+    uint32_t ts;                /* bucket start */
+    uint16_t count;
+    int8_t   t_min, t_max;
+    uint8_t  h_min, h_max;
+    int16_t  t_avg_x10;
+    uint16_t h_avg_x10;
+    uint16_t di_min, di_max, di_avg;    /* x10 */
+    uint8_t  pad[6];
+    uint16_t crc;
+};
+
+struct hist_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t cap[HIST_TIERS];
+    uint32_t off[HIST_TIERS];
+    uint32_t pad[6];
+};
+
+struct hist_ring {
+    uint32_t off, cap, rec_size;
+    uint32_t head;              /* next slot to write */
+    uint32_t seq;               /* newest committed seq */
+    uint8_t  pend[HIST_PENDING][sizeof(struct hist_rollup)];
+    int      npend;
+};
+
+struct hist_acc {
+    uint32_t bucket;
+    uint32_t n;
+    int t_min, t_max, h_min, h_max, di_min, di_max;
+    long t_sum, h_sum, di_sum;  /* x10, weighted by n */
+};
+
+struct history {
+    int fd;
+    uint8_t *map;
+    size_t size;
+
+    struct hist_ring ring[HIST_TIERS];
+    struct hist_acc acc_min, acc_hour;
+
+    uint32_t last_commit;
+};
+
+/* one graphable point; rollups fill min/max, raw samples have min == max */
+struct hist_point {
+    uint32_t ts;
+    int t_x10, t_min, t_max;
+    int h_x10, h_min, h_max;
+    int di_x10, di_min, di_max;
+};
+
+int  history_open(struct history *h, const char *path,
+                  uint32_t raw_cap, uint32_t min_cap, uint32_t hour_cap);
+void history_close(struct history *h);
+
+int  history_append(struct history *h, uint32_t ts, int temp, int hum, int di_x10, int status);
+int  history_commit(struct history *h);
+
+uint32_t history_seq(const struct history *h, enum hist_tier tier);
+int  history_get(const struct history *h, enum hist_tier tier, uint32_t back, struct hist_point *p);
+
+#endif
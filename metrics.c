@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+#include "oled.h"
+#include "clock_client.h"
+
+#define METRICS_MAX_DISPLAYS 4
+
+const unsigned long metrics_bucket_us[METRICS_BUCKETS] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000
+};
+
+struct metrics metrics = {
+    .di_x10 = -1,
+};
+
+static struct oled *displays[METRICS_MAX_DISPLAYS];
+static int ndisplays;
+static struct clock_client *client;
+
+static int listen_fd = -1;
+static pthread_t server_thread;
+static char sock_path[108];
+
+long long metrics_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+void metrics_hist_observe(struct metrics_hist *h, unsigned long us) {
+    int i = 0;
+    while (i < METRICS_BUCKETS && us > metrics_bucket_us[i]) i++;
+    atomic_fetch_add_explicit(&h->bucket[i], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_us, us, memory_order_relaxed);
+}
+
+void metrics_add_display(struct oled *o) {
+    if (ndisplays < METRICS_MAX_DISPLAYS) displays[ndisplays++] = o;
+}
+
+void metrics_set_client(struct clock_client *cc) {
+    client = cc;
+}
+
+
+static void put_hist(FILE *f, const char *name, const char *help,
+                     const char *labels, const struct metrics_hist *h, int header) {
+    unsigned long cum = 0;
+    const char *sep = labels[0] ? "," : "";
+
+    if (header) {
+        fprintf(f, "# HELP %s %s\n", name, help);
+        fprintf(f, "# TYPE %s histogram\n", name);
+    }
+    for (int i = 0; i <= METRICS_BUCKETS; i++) {
+        cum += atomic_load(&h->bucket[i]);
+        if (i < METRICS_BUCKETS)
+            fprintf(f, "%s_bucket{%s%sle=\"%g\"} %lu\n", name, labels, sep,
+                    metrics_bucket_us[i] / 1e6, cum);
+        else
+            fprintf(f, "%s_bucket{%s%sle=\"+Inf\"} %lu\n", name, labels, sep, cum);
+    }
+    fprintf(f, "%s_sum%s%s%s %g\n", name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "",
+            atomic_load(&h->sum_us) / 1e6);
+    fprintf(f, "%s_count%s%s%s %lu\n", name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "",
+            atomic_load(&h->count));
+}
+
+static void put_scalar(FILE *f, const char *name, const char *type, const char *help, double v) {
+    fprintf(f, "# HELP %s %s\n# TYPE %s %s\n%s %g\n", name, help, name, type, name, v);
+}
+
+#define PER_DISPLAY(f, name, type, help, expr) do {                             \
+        fprintf(f, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);   \
+        for (int i = 0; i < ndisplays; i++) {                                   \
+            struct oled *o = displays[i];                                       \
+            fprintf(f, "%s{panel=\"%d\"} %lu\n", name, i, (unsigned long)(expr)); \
+        }                                                                       \
+    } while (0)
+
+static void metrics_write(FILE *f) {
+    long long now_ms = metrics_now_us() / 1000;
+    long long last_ok = atomic_load(&metrics.sensor_last_ok_ms);
+    int di = atomic_load(&metrics.di_x10);
+    char labels[32];
+
+    put_hist(f, "di_frame_render_seconds", "Time to render one frame into the back buffer.",
+             "", &metrics.render_us, 1);
+    put_scalar(f, "di_frames_rendered_total", "counter", "Frames rendered.",
+               atomic_load(&metrics.frames_rendered));
+
+    for (int i = 0; i < ndisplays; i++) {
+        snprintf(labels, sizeof(labels), "panel=\"%d\"", i);
+        put_hist(f, "di_frame_flush_seconds", "Time to push one frame to the panel.",
+                 labels, &displays[i]->flush_us, i == 0);
+    }
+    PER_DISPLAY(f, "di_frames_flushed_total", "counter", "Frames sent to the panel.",
+                atomic_load(&o->frames_sent));
+    PER_DISPLAY(f, "di_frames_dropped_total", "counter", "Frames superseded before they were sent.",
+                atomic_load(&o->frames_dropped));
+    PER_DISPLAY(f, "di_i2c_bytes_total", "counter", "Bytes written to the display bus.",
+                atomic_load(&o->tx_bytes));
+    PER_DISPLAY(f, "di_i2c_transactions_total", "counter", "Bus transactions (write syscalls on i2c).",
+                atomic_load(&o->tx_count));
+    PER_DISPLAY(f, "di_i2c_bytes_per_frame", "gauge", "Bytes written for the last frame.",
+                atomic_load(&o->last_frame_bytes));
+    PER_DISPLAY(f, "di_i2c_transactions_per_frame", "gauge", "Transactions for the last frame.",
+                atomic_load(&o->last_frame_tx));
+
+    if (client) {
+        put_hist(f, "di_device_read_seconds", "Latency of one /dev/clock_drv status read.",
+                 "", &client->read_us, 1);
+        put_scalar(f, "di_device_syscalls_total", "counter", "read/write/open calls on /dev/clock_drv.",
+                   atomic_load(&client->syscalls));
+        put_scalar(f, "di_device_errors_total", "counter", "Failed /dev/clock_drv reads or writes.",
+                   atomic_load(&client->errors));
+    }
+
+    put_scalar(f, "di_sensor_samples_total", "counter", "DHT11 samples taken.",
+               atomic_load(&metrics.sensor_samples));
+    put_scalar(f, "di_sensor_invalid_total", "counter", "Samples with missing or out-of-range values.",
+               atomic_load(&metrics.sensor_invalid));
+    put_scalar(f, "di_sensor_staleness_seconds", "gauge", "Time since the last valid sample, -1 = never.",
+               last_ok ? (now_ms - last_ok) / 1000.0 : -1);
+    put_scalar(f, "di_discomfort_index", "gauge", "Current smoothed DI, -1 = no data.",
+               di < 0 ? -1 : di / 10.0);
+    put_scalar(f, "di_led_level", "gauge", "LED bar level.",
+               atomic_load(&metrics.led_level));
+}
+
+
+static void *metrics_main(void *arg) {
+    (void)arg;
+
+    for (;;) {
+        int c = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (c < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+
+        struct timeval tv = { 1, 0 };
+        setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        /* format first, then send with MSG_NOSIGNAL: a scraper that hangs
+         * up early must not take the process down with SIGPIPE */
+        char *text = NULL;
+        size_t len = 0, off = 0;
+        FILE *f = open_memstream(&text, &len);
+        if (!f) { close(c); continue; }
+        metrics_write(f);
+        fclose(f);
+
+        while (off < len) {
+            ssize_t n = send(c, text + off, len - off, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            off += (size_t)n;
+        }
+        free(text);
+        close(c);
+    }
+    return NULL;
+}
+
+int metrics_serve(const char *path) {
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "metrics: socket path too long\n");
+        return -1;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) { perror("metrics socket"); return -1; }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listen_fd, 4) != 0) {
+        perror(path);
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+    strcpy(sock_path, path);
+
+    if (pthread_create(&server_thread, NULL, metrics_main, NULL) != 0) {
+        perror("metrics thread");
+        close(listen_fd);
+        listen_fd = -1;
+        unlink(sock_path);
+        return -1;
+    }
+    return 0;
+}
+
+void metrics_stop(void) {
+    if (listen_fd < 0) return;
+    shutdown(listen_fd, SHUT_RDWR);
+    pthread_join(server_thread, NULL);
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(sock_path);
+}
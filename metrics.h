@@ -0,0 +1,43 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+
+struct oled;
+struct clock_client;
+
+/* upper bounds in microseconds, plus an implicit +Inf bucket */
+#define METRICS_BUCKETS 12
+extern const unsigned long metrics_bucket_us[METRICS_BUCKETS];
+
+struct metrics_hist {
+    atomic_ulong bucket[METRICS_BUCKETS + 1];
+    atomic_ulong count;
+    atomic_ulong sum_us;
+};
+
+void metrics_hist_observe(struct metrics_hist *h, unsigned long us);
+long long metrics_now_us(void);
+
+struct metrics {
+    struct metrics_hist render_us;
+    atomic_ulong frames_rendered;
+
+    atomic_llong sensor_last_ok_ms;     /* CLOCK_MONOTONIC ms, 0 = never */
+    atomic_ulong sensor_samples;
+    atomic_ulong sensor_invalid;
+
+    atomic_int di_x10;                  /* -1 = no data */
+    atomic_int led_level;
+};
+
+extern struct metrics metrics;
+
+void metrics_add_display(struct oled *o);
+void metrics_set_client(struct clock_client *cc);
+
+/* text exposition on a unix stream socket, served from its own thread */
+int  metrics_serve(const char *path);
+void metrics_stop(void);
+
+#endif
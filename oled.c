@@ -0,0 +1,342 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+#include "oled.h"
+
+static int i2c_open(struct oled *o, const char *arg) {
+    (void)arg;
+    o->fd = open(o->dev, O_RDWR | O_CLOEXEC);
+    if (o->fd < 0) { perror("open i2c"); return -1; }
+    if (ioctl(o->fd, I2C_SLAVE, o->addr) < 0) {
+        perror("ioctl I2C_SLAVE");
+        close(o->fd);
+        o->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static int i2c_xfer(struct oled *o, const uint8_t *buf, size_t n) {
+    return (write(o->fd, buf, n) == (ssize_t)n) ? 0 : -1;
+}
+
+static void i2c_close(struct oled *o) {
+    if (o->fd >= 0) close(o->fd);
+    o->fd = -1;
+}
+
+const struct oled_backend oled_backend_i2c = {
+    .name  = "i2c",
+    .open  = i2c_open,
+    .xfer  = i2c_xfer,
+    .close = i2c_close,
+};
+
+static const struct oled_backend *backends[] = {
+    &oled_backend_i2c,
+    &oled_backend_sim,
+    &oled_backend_pbm,
+};
+
+int oled_open(struct oled *o, const char *spec, const char *dev, int addr) {
+    char name[16];
+    const char *arg = NULL;
+    size_t len;
+
+    memset(o, 0, sizeof(*o));
+    o->fd = -1;
+    o->dev = dev;
+    o->addr = addr;
+    o->back = 0;
+    o->front = 1;
+    atomic_init(&o->ready, 2);
+    atomic_init(&o->want_on, 1);
+    atomic_init(&o->want_contrast, OLED_CONTRAST_DEFAULT);
+    o->cur_on = 1;
+    o->cur_contrast = OLED_CONTRAST_DEFAULT;
+
+    if (!spec) spec = "i2c";
+    len = strcspn(spec, ":");
+    if (spec[len] == ':') arg = spec + len + 1;
+    if (len >= sizeof(name)) len = sizeof(name) - 1;
+    memcpy(name, spec, len);
+    name[len] = 0;
+
+    for (size_t i = 0; i < sizeof(backends)/sizeof(backends[0]); i++) {
+        if (strcmp(backends[i]->name, name) == 0) {
+            o->be = backends[i];
+            return o->be->open(o, arg);
+        }
+    }
+    fprintf(stderr, "oled: unknown backend '%s'\n", name);
+    return -1;
+}
+
+void oled_close(struct oled *o) {
+    oled_stop(o);
+    if (o->be && o->be->close) o->be->close(o);
+    o->be = NULL;
+}
+
+static void oled_xfer(struct oled *o, const uint8_t *buf, size_t n) {
+    (void)o->be->xfer(o, buf, n);
+    atomic_fetch_add_explicit(&o->tx_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&o->tx_bytes, n, memory_order_relaxed);
+}
+
+static void oled_cmd(struct oled *o, uint8_t c) {
+    uint8_t buf[2] = {0x00, c};
+    oled_xfer(o, buf, 2);
+}
+
+static void oled_data_chunk(struct oled *o, const uint8_t *d, size_t n) {
+    uint8_t buf[1 + 16];
+    while (n > 0) {
+        size_t m = (n > 16) ? 16 : n;
+        buf[0] = 0x40;
+        memcpy(&buf[1], d, m);
+        oled_xfer(o, buf, 1 + m);
+        d += m;
+        n -= m;
+    }
+}
+
+void oled_init(struct oled *o) {
+    oled_cmd(o, 0xAE);
+    oled_cmd(o, 0xD5); oled_cmd(o, 0x80);
+    oled_cmd(o, 0xA8); oled_cmd(o, 0x3F);
+    oled_cmd(o, 0xD3); oled_cmd(o, 0x00);
+    oled_cmd(o, 0x40);
+    oled_cmd(o, 0x8D); oled_cmd(o, 0x14);
+    oled_cmd(o, 0x20); oled_cmd(o, 0x00);
+    oled_cmd(o, 0xA1);
+    oled_cmd(o, 0xC8);
+    oled_cmd(o, 0xDA); oled_cmd(o, 0x12);
+    oled_cmd(o, 0x81); oled_cmd(o, OLED_CONTRAST_DEFAULT);
+    oled_cmd(o, 0xD9); oled_cmd(o, 0xF1);
+    oled_cmd(o, 0xDB); oled_cmd(o, 0x40);
+    oled_cmd(o, 0xA4);
+    oled_cmd(o, 0xA6);
+    oled_cmd(o, 0xAF);
+}
+
+void oled_flush(struct oled *o, const uint8_t *fb) {
+    oled_cmd(o, 0x21); oled_cmd(o, 0); oled_cmd(o, 127);
+    oled_cmd(o, 0x22); oled_cmd(o, 0); oled_cmd(o, 7);
+    oled_data_chunk(o, fb, OLED_FB_SIZE);
+    if (o->be->frame_done) o->be->frame_done(o);
+
+    memcpy(o->sent, fb, OLED_FB_SIZE);
+    o->has_sent = 1;
+}
+
+/* rewrite only the span of pages that differ from what the panel shows */
+void oled_flush_dirty(struct oled *o, const uint8_t *fb) {
+    int first = -1, last = -1;
+
+    if (!o->has_sent) { oled_flush(o, fb); return; }
+
+    for (int p = 0; p < OLED_H / 8; p++) {
+        if (memcmp(fb + p*OLED_W, o->sent + p*OLED_W, OLED_W) != 0) {
+            if (first < 0) first = p;
+            last = p;
+        }
+    }
+    if (first < 0) return;
+
+    oled_cmd(o, 0x21); oled_cmd(o, 0); oled_cmd(o, 127);
+    oled_cmd(o, 0x22); oled_cmd(o, first); oled_cmd(o, last);
+    oled_data_chunk(o, fb + first*OLED_W, (size_t)(last - first + 1) * OLED_W);
+    if (o->be->frame_done) o->be->frame_done(o);
+
+    memcpy(o->sent + first*OLED_W, fb + first*OLED_W, (size_t)(last - first + 1) * OLED_W);
+}
+
+static void oled_sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) ;
+}
+
+/*
+ * One transaction: every command with its own Co=1 control byte, then the
+ * data.  Used so the start-line change and the page that fills the row it
+ * uncovered reach the panel together.
+ */
+static void oled_cmds_data(struct oled *o, const uint8_t *cmds, size_t nc,
+                           const uint8_t *d, size_t n) {
+    uint8_t buf[2*8 + 1 + OLED_W];
+    size_t len = 0;
+
+    for (size_t i = 0; i < nc; i++) {
+        buf[len++] = 0x80;
+        buf[len++] = cmds[i];
+    }
+    buf[len++] = 0x40;
+    memcpy(&buf[len], d, n);
+    oled_xfer(o, buf, len + n);
+}
+
+static void oled_roll(struct oled *o, const uint8_t *fb, int up) {
+    const int pages = OLED_H / 8;
+
+    /*
+     * Display row y shows GDDRAM row (y + start) % 64, so after stepping the
+     * start line by one page the row that wrapped around is exactly where
+     * the matching page of the new frame belongs.
+     */
+    for (int k = 1; k <= pages; k++) {
+        int p = up ? k - 1 : pages - k;
+        int start = up ? (8*k) % OLED_H : OLED_H - 8*k;
+        uint8_t cmds[7] = { 0x21, 0, OLED_W - 1, 0x22, (uint8_t)p, (uint8_t)p,
+                            (uint8_t)(0x40 | start) };
+
+        oled_cmds_data(o, cmds, sizeof(cmds), fb + p*OLED_W, OLED_W);
+        if (o->be->frame_done) o->be->frame_done(o);
+        if (k < pages) oled_sleep_ms(OLED_ROLL_STEP_MS);
+    }
+    memcpy(o->sent, fb, OLED_FB_SIZE);
+    o->has_sent = 1;
+}
+
+static void oled_slide(struct oled *o, const uint8_t *fb, int left) {
+    /* dummy, first page, 2-frame interval, last page, dummy, dummy */
+    oled_cmd(o, left ? 0x27 : 0x26);
+    oled_cmd(o, 0x00); oled_cmd(o, 0); oled_cmd(o, 0x07);
+    oled_cmd(o, OLED_H/8 - 1); oled_cmd(o, 0x00); oled_cmd(o, 0xFF);
+    oled_cmd(o, 0x2F);
+    oled_sleep_ms(OLED_SLIDE_MS);
+    oled_cmd(o, 0x2E);
+
+    /* scrolling rotates GDDRAM, so nothing of what was sent is still valid */
+    oled_flush(o, fb);
+}
+
+void oled_transition(struct oled *o, const uint8_t *fb, enum oled_transition tr) {
+    switch (tr) {
+    case OLED_TR_ROLL_UP:     oled_roll(o, fb, 1); break;
+    case OLED_TR_ROLL_DOWN:   oled_roll(o, fb, 0); break;
+    case OLED_TR_SLIDE_LEFT:  oled_slide(o, fb, 1); break;
+    case OLED_TR_SLIDE_RIGHT: oled_slide(o, fb, 0); break;
+    default:                  oled_flush_dirty(o, fb); break;
+    }
+}
+
+
+uint8_t *oled_back(struct oled *o) {
+    return o->slot[o->back];
+}
+
+int oled_present(struct oled *o) {
+    return oled_present_tr(o, OLED_TR_NONE);
+}
+
+int oled_present_tr(struct oled *o, enum oled_transition tr) {
+    if (o->has_presented && memcmp(o->presented, o->slot[o->back], OLED_FB_SIZE) == 0)
+        return 0;
+    o->slot_tr[o->back] = (uint8_t)tr;
+    memcpy(o->presented, o->slot[o->back], OLED_FB_SIZE);
+    o->has_presented = 1;
+
+    unsigned prev = atomic_exchange(&o->ready, o->back | OLED_READY_NEW);
+    if (prev & OLED_READY_NEW)
+        atomic_fetch_add(&o->frames_dropped, 1);
+    o->back = prev & ~OLED_READY_NEW;
+    sem_post(&o->wake);
+    return 1;
+}
+
+void oled_set_power(struct oled *o, int on, int contrast) {
+    if (atomic_load(&o->want_on) == on && atomic_load(&o->want_contrast) == contrast)
+        return;
+    atomic_store(&o->want_contrast, contrast);
+    atomic_store(&o->want_on, on);
+    sem_post(&o->wake);
+}
+
+static void oled_send_frame(struct oled *o) {
+    unsigned prev = atomic_exchange(&o->ready, o->front);
+    o->front = prev & ~OLED_READY_NEW;
+
+    unsigned long bytes0 = atomic_load(&o->tx_bytes);
+    unsigned long tx0 = atomic_load(&o->tx_count);
+    long long t0 = metrics_now_us();
+
+    /* a transition on a blank or unknown panel would only be slower */
+    if (o->slot_tr[o->front] != OLED_TR_NONE && o->has_sent && o->cur_on)
+        oled_transition(o, o->slot[o->front], o->slot_tr[o->front]);
+    else
+        oled_flush_dirty(o, o->slot[o->front]);
+
+    metrics_hist_observe(&o->flush_us, (unsigned long)(metrics_now_us() - t0));
+    atomic_store(&o->last_frame_bytes, atomic_load(&o->tx_bytes) - bytes0);
+    atomic_store(&o->last_frame_tx, atomic_load(&o->tx_count) - tx0);
+    atomic_fetch_add(&o->frames_sent, 1);
+}
+
+static void *oled_transport_main(void *arg) {
+    struct oled *o = arg;
+
+    while (atomic_load(&o->running)) {
+        while (sem_wait(&o->wake) != 0 && errno == EINTR) ;
+
+        int on = atomic_load(&o->want_on);
+        int contrast = atomic_load(&o->want_contrast);
+
+        if (contrast != o->cur_contrast) {
+            oled_cmd(o, 0x81); oled_cmd(o, (uint8_t)contrast);
+            o->cur_contrast = contrast;
+        }
+        if (!on && o->cur_on) {
+            oled_cmd(o, 0xAE);
+            o->cur_on = 0;
+        }
+
+        if (atomic_load(&o->ready) & OLED_READY_NEW)
+            oled_send_frame(o);
+
+        /* switch on only after the fresh frame is in GDDRAM */
+        if (on && !o->cur_on) {
+            oled_cmd(o, 0xAF);
+            o->cur_on = 1;
+        }
+    }
+    return NULL;
+}
+
+int oled_start(struct oled *o, int cpu) {
+    if (sem_init(&o->wake, 0, 0) != 0) { perror("sem_init"); return -1; }
+    atomic_store(&o->running, 1);
+
+    int err = pthread_create(&o->thread, NULL, oled_transport_main, o);
+    if (err) {
+        errno = err;
+        perror("pthread_create");
+        atomic_store(&o->running, 0);
+        sem_destroy(&o->wake);
+        return -1;
+    }
+
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        err = pthread_setaffinity_np(o->thread, sizeof(set), &set);
+        if (err) fprintf(stderr, "oled: cannot pin transport to cpu %d: %s\n", cpu, strerror(err));
+    }
+    return 0;
+}
+
+void oled_stop(struct oled *o) {
+    if (!atomic_exchange(&o->running, 0)) return;
+    sem_post(&o->wake);
+    pthread_join(o->thread, NULL);
+    sem_destroy(&o->wake);
+}
@@ -0,0 +1,125 @@
+#ifndef OLED_IF_H
+#define OLED_IF_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+#include "metrics.h"
+
+#define I2C_DEV "/dev/i2c-1"
+#define OLED_I2C_ADDR 0x3C
+
+#define OLED_W 128
+#define OLED_H 64
+#define OLED_FB_SIZE (OLED_W * OLED_H / 8)
+
+#define OLED_CONTRAST_DEFAULT 0xCF
+
+/*
+ * Page transitions done by the controller itself.  ROLL steps the display
+ * start line (0x40-0x7F) one 8-row page at a time and writes only the page
+ * that just came into view; SLIDE runs the horizontal scroll (0x26/0x27,
+ * 0x2F) for a moment, stops it (0x2E) and then rewrites the frame.
+ */
+enum oled_transition {
+    OLED_TR_NONE,
+    OLED_TR_ROLL_UP,        /* new frame comes in from the bottom */
+    OLED_TR_ROLL_DOWN,      /* ... from the top */
+    OLED_TR_SLIDE_LEFT,
+    OLED_TR_SLIDE_RIGHT,
+};
+
+#define OLED_ROLL_STEP_MS  16
+#define OLED_SLIDE_MS      150
+
+struct oled;
+
+/*
+ * Where the SSD1306 byte stream goes.  xfer() is one bus transaction:
+ * a control byte (0x00 command / 0x40 data) followed by its payload.
+ */
+struct oled_backend {
+    const char *name;
+    int  (*open)(struct oled *o, const char *arg);
+    int  (*xfer)(struct oled *o, const uint8_t *buf, size_t n);
+    void (*frame_done)(struct oled *o);     /* optional, after every flush */
+    void (*close)(struct oled *o);
+};
+
+extern const struct oled_backend oled_backend_i2c;
+extern const struct oled_backend oled_backend_sim;
+extern const struct oled_backend oled_backend_pbm;
+
+/*
+ * SSD1306 with a transport thread.
+ *
+ * The render side draws into oled_back() and hands the frame over with
+ * oled_present(); the transport thread always sends the newest presented
+ * frame.  Three slots are used so neither side ever waits: one being drawn,
+ * one being sent, and one holding the latest finished frame.  A frame that
+ * is superseded before the transport picks it up is simply dropped.
+ * Frames identical to the previous one are not handed over at all, and
+ * the transport only rewrites the 8-row pages that changed.
+ */
+struct oled {
+    const struct oled_backend *be;
+    void *priv;
+
+    int fd;
+    const char *dev;
+    int addr;
+
+    atomic_ulong tx_count;
+    atomic_ulong tx_bytes;
+
+    uint8_t slot[3][OLED_FB_SIZE];
+    atomic_uint ready;      /* slot index | OLED_READY_NEW */
+    unsigned back;          /* owned by the render side */
+    unsigned front;         /* owned by the transport thread */
+    uint8_t slot_tr[3];     /* transition to the frame in each slot, travels with it */
+
+    uint8_t presented[OLED_FB_SIZE];    /* render side: last frame handed over */
+    int has_presented;
+    uint8_t sent[OLED_FB_SIZE];         /* transport: what the panel shows */
+    int has_sent;
+
+    sem_t wake;
+    pthread_t thread;
+    atomic_int running;
+
+    atomic_int want_on;                 /* requested by the render side */
+    atomic_int want_contrast;
+    int cur_on, cur_contrast;           /* what the panel was last told */
+
+    atomic_ulong frames_sent;
+    atomic_ulong frames_dropped;
+    atomic_ulong last_frame_bytes;
+    atomic_ulong last_frame_tx;
+    struct metrics_hist flush_us;
+};
+
+#define OLED_READY_NEW 0x4u
+
+/* spec is "<backend>[:arg]", e.g. "i2c", "sim:400", "pbm:/tmp/frames"; NULL = i2c */
+int  oled_open(struct oled *o, const char *spec, const char *dev, int addr);
+void oled_close(struct oled *o);
+
+void oled_init(struct oled *o);
+void oled_flush(struct oled *o, const uint8_t *fb);
+void oled_flush_dirty(struct oled *o, const uint8_t *fb);
+void oled_transition(struct oled *o, const uint8_t *fb, enum oled_transition tr);
+
+int  oled_start(struct oled *o, int cpu);
+void oled_stop(struct oled *o);
+
+uint8_t *oled_back(struct oled *o);
+int  oled_present(struct oled *o);
+int  oled_present_tr(struct oled *o, enum oled_transition tr);
+
+/* applied by the transport thread: contrast 0x81, display on/off 0xAF/0xAE */
+void oled_set_power(struct oled *o, int on, int contrast);
+
+#endif
@@ -0,0 +1,167 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "oled.h"
+#include "raster.h"
+
+static inline void apply(uint8_t *b, uint8_t m, enum raster_op op) {
+    if (op == RASTER_SET)        *b |= m;
+    else if (op == RASTER_CLEAR) *b &= (uint8_t)~m;
+    else                         *b ^= m;
+}
+
+/* bits y0..y1 (0..7) of a page byte */
+static inline uint8_t page_mask(int y0, int y1) {
+    return (uint8_t)((0xFF << y0) & (0xFF >> (7 - y1)));
+}
+
+void raster_pixel(uint8_t *fb, int x, int y, enum raster_op op) {
+    if (x < 0 || x >= OLED_W || y < 0 || y >= OLED_H) return;
+    apply(&fb[(y >> 3) * OLED_W + x], (uint8_t)(1u << (y & 7)), op);
+}
+
+void raster_hspan(uint8_t *fb, int x0, int x1, int y, enum raster_op op) {
+    if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+    if (y < 0 || y >= OLED_H || x1 < 0 || x0 >= OLED_W) return;
+    if (x0 < 0) x0 = 0;
+    if (x1 > OLED_W - 1) x1 = OLED_W - 1;
+
+    uint8_t *row = fb + (y >> 3) * OLED_W;
+    uint8_t m = (uint8_t)(1u << (y & 7));
+    for (int x = x0; x <= x1; x++) apply(&row[x], m, op);
+}
+
+void raster_vspan(uint8_t *fb, int x, int y0, int y1, enum raster_op op) {
+    if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+    if (x < 0 || x >= OLED_W || y1 < 0 || y0 >= OLED_H) return;
+    if (y0 < 0) y0 = 0;
+    if (y1 > OLED_H - 1) y1 = OLED_H - 1;
+
+    int p0 = y0 >> 3, p1 = y1 >> 3;
+    for (int p = p0; p <= p1; p++) {
+        uint8_t m = page_mask(p == p0 ? (y0 & 7) : 0, p == p1 ? (y1 & 7) : 7);
+        apply(&fb[p * OLED_W + x], m, op);
+    }
+}
+
+void raster_rect(uint8_t *fb, int x, int y, int w, int h, enum raster_op op) {
+    int x1 = x + w - 1, y1 = y + h - 1;
+
+    if (w <= 0 || h <= 0 || x1 < 0 || y1 < 0 || x >= OLED_W || y >= OLED_H) return;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x1 > OLED_W - 1) x1 = OLED_W - 1;
+    if (y1 > OLED_H - 1) y1 = OLED_H - 1;
+
+    int p0 = y >> 3, p1 = y1 >> 3;
+    for (int p = p0; p <= p1; p++) {
+        uint8_t m = page_mask(p == p0 ? (y & 7) : 0, p == p1 ? (y1 & 7) : 7);
+        uint8_t *row = fb + p * OLED_W;
+
+        if (m == 0xFF && op != RASTER_INVERT) {
+            memset(row + x, op == RASTER_SET ? 0xFF : 0x00, (size_t)(x1 - x + 1));
+            continue;
+        }
+        for (int c = x; c <= x1; c++) apply(&row[c], m, op);
+    }
+}
+
+static inline void set_px(uint8_t *fb, int x, int y) {
+    fb[(y >> 3) * OLED_W + x] |= (uint8_t)(1u << (y & 7));
+}
+
+void raster_circle(uint8_t *fb, int cx, int cy, int r) {
+    int inside = cx - r >= 0 && cx + r < OLED_W && cy - r >= 0 && cy + r < OLED_H;
+    int x = r, y = 0, err = 1 - r;
+
+    if (r < 0) return;
+
+    while (x >= y) {
+        const int px[8] = { cx+x, cx-x, cx+x, cx-x, cx+y, cx-y, cx+y, cx-y };
+        const int py[8] = { cy+y, cy+y, cy-y, cy-y, cy+x, cy+x, cy-x, cy-x };
+
+        for (int i = 0; i < 8; i++) {
+            if (inside) set_px(fb, px[i], py[i]);
+            else        raster_pixel(fb, px[i], py[i], RASTER_SET);
+        }
+
+        y++;
+        if (err < 0) {
+            err += 2*y + 1;
+        } else {
+            x--;
+            err += 2*(y - x) + 1;
+        }
+    }
+}
+
+void raster_disc(uint8_t *fb, int cx, int cy, int r) {
+    int h = r;
+
+    if (r < 0) return;
+
+    /* one vertical span per column, the half height shrinking as dx grows */
+    for (int dx = 0; dx <= r; dx++) {
+        while (dx*dx + h*h > r*r) h--;
+        raster_vspan(fb, cx + dx, cy - h, cy + h, RASTER_SET);
+        if (dx) raster_vspan(fb, cx - dx, cy - h, cy + h, RASTER_SET);
+    }
+}
+
+/* every bit of the column becomes `scale` bits */
+static uint32_t spread(uint8_t c, int h, int scale) {
+    uint32_t out = 0, blk = (1u << scale) - 1;
+
+    for (int j = 0; j < h; j++)
+        if ((c >> j) & 1) out |= blk << (j * scale);
+    return out;
+}
+
+void raster_blit(uint8_t *fb, int x, int y, const uint8_t *cols, int w, int h, int scale) {
+    if (scale < 1) scale = 1;
+    if (scale > 4) scale = 4;
+    if (h > 8) h = 8;
+
+    int ww = w * scale, hh = h * scale;
+    if (ww <= 0 || hh <= 0 || x + ww <= 0 || x >= OLED_W || y + hh <= 0 || y >= OLED_H) return;
+
+    /* clip once: visible columns, rows dropped above the top, rows kept */
+    int c0 = x < 0 ? -x : 0;
+    int c1 = (x + ww > OLED_W) ? OLED_W - x : ww;
+    int y0 = y < 0 ? 0 : y;
+    int drop = y0 - y;
+    int keep = hh - drop;
+    if (keep > OLED_H - y0) keep = OLED_H - y0;
+
+    uint32_t vmask = (keep >= 32) ? 0xFFFFFFFFu : ((1u << keep) - 1);
+    uint8_t *col0 = fb + (y0 >> 3) * OLED_W;
+    int shift = y0 & 7;
+
+    /* each source column is expanded and shifted once, then written `scale` times */
+    for (int sc = c0 / scale; sc * scale < c1; sc++) {
+        uint32_t bits = (scale == 1) ? (uint32_t)(cols[sc] & ((1u << h) - 1)) : spread(cols[sc], h, scale);
+        uint64_t v0 = (uint64_t)((bits >> drop) & vmask) << shift;
+        int d0 = sc * scale, d1 = d0 + scale;
+
+        if (d0 < c0) d0 = c0;
+        if (d1 > c1) d1 = c1;
+        for (int c = d0; c < d1; c++) {
+            uint64_t v = v0;
+            for (uint8_t *b = col0 + x + c; v; b += OLED_W, v >>= 8)
+                *b |= (uint8_t)v;
+        }
+    }
+}
+
+void raster_icon_cols(const uint8_t rows[8], uint8_t cols[8]) {
+    uint64_t x = 0, t;
+
+    for (int r = 0; r < 8; r++) x |= (uint64_t)rows[r] << (8 * r);
+
+    /* 8x8 bit transpose: bit 8r+c moves to 8c+r */
+    t = (x ^ (x >> 7))  & 0x00AA00AA00AA00AAULL; x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL; x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL; x ^= t ^ (t << 28);
+
+    for (int c = 0; c < 8; c++) cols[c] = (uint8_t)(x >> (8 * c));
+}
@@ -0,0 +1,36 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdint.h>
+
+/*
+ * Drawing straight into the SSD1306 page layout: byte [p*OLED_W + x] holds
+ * rows 8p..8p+7 of column x, LSB on top.  Every primitive clips once up
+ * front and then writes whole bytes under a mask, so the cost follows the
+ * number of bytes touched rather than the number of pixels.
+ */
+enum raster_op { RASTER_SET, RASTER_CLEAR, RASTER_INVERT };
+
+void raster_pixel(uint8_t *fb, int x, int y, enum raster_op op);
+
+/* inclusive end points, in either order */
+void raster_hspan(uint8_t *fb, int x0, int x1, int y, enum raster_op op);
+void raster_vspan(uint8_t *fb, int x, int y0, int y1, enum raster_op op);
+
+void raster_rect(uint8_t *fb, int x, int y, int w, int h, enum raster_op op);
+
+/* midpoint circle outline, and the filled disc x^2 + y^2 <= r^2 */
+void raster_circle(uint8_t *fb, int cx, int cy, int r);
+void raster_disc(uint8_t *fb, int cx, int cy, int r);
+
+/*
+ * 1-bpp sprite ORed in at any y: one byte per column, LSB = top row, at
+ * most 8 rows (the font and the page layout use the same format).  With
+ * scale > 1 (up to 4) every pixel becomes a scale x scale block.
+ */
+void raster_blit(uint8_t *fb, int x, int y, const uint8_t *cols, int w, int h, int scale);
+
+/* row-major 8x8 icon (bit c of row r = pixel c, r) to the column format above */
+void raster_icon_cols(const uint8_t rows[8], uint8_t cols[8]);
+
+#endif
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "graph.h"
+#include "oled.h"
+#include "raster.h"
+#include "render.h"
+
+static uint8_t *fb;
+
+static const char *const graph_win_label[HIST_TIERS] = { "20m", "2h", "5d" };
+
+static struct graph g_temp, g_hum, g_di;
+
+void fb_target(uint8_t *buf) { fb = buf; }
+
+void fb_clear(void) { memset(fb, 0, OLED_FB_SIZE); }
+
+void fb_set_px(int x, int y, int on) {
+    raster_pixel(fb, x, y, on ? RASTER_SET : RASTER_CLEAR);
+}
+
+static const uint8_t font5x7_digits[][5] = {
+    {0x3E,0x51,0x49,0x45,0x3E},{0x00,0x42,0x7F,0x40,0x00},
+    {0x42,0x61,0x51,0x49,0x46},{0x21,0x41,0x45,0x4B,0x31},
+    {0x18,0x14,0x12,0x7F,0x10},{0x27,0x45,0x45,0x45,0x39},
+    {0x3C,0x4A,0x49,0x49,0x30},{0x01,0x71,0x09,0x05,0x03},
+    {0x36,0x49,0x49,0x49,0x36},{0x06,0x49,0x49,0x29,0x1E}
+};
+static const uint8_t font_colon[5] = {0x00,0x36,0x36,0x00,0x00};
+
+static const uint8_t font_E[5]={0x7F,0x49,0x49,0x49,0x41};
+static const uint8_t font_D[5]={0x7F,0x41,0x41,0x22,0x1C};
+static const uint8_t font_I[5]={0x00,0x41,0x7F,0x41,0x00};
+static const uint8_t font_T[5]={0x01,0x01,0x7F,0x01,0x01};
+static const uint8_t font_R[5]={0x7F,0x09,0x19,0x29,0x46};
+static const uint8_t font_U[5]={0x3F,0x40,0x40,0x40,0x3F};
+static const uint8_t font_N[5]={0x7F,0x06,0x18,0x60,0x7F};
+static const uint8_t font_W[5]={0x7F,0x20,0x18,0x20,0x7F};
+static const uint8_t font_H[5]={0x7F,0x08,0x08,0x08,0x7F};
+static const uint8_t font_M[5]={0x7F,0x02,0x04,0x02,0x7F};
+static const uint8_t font_S[5]={0x46,0x49,0x49,0x49,0x31};
+static const uint8_t font_G[5]={0x3E,0x41,0x41,0x51,0x32};
+static const uint8_t font_P[5]={0x7F,0x09,0x09,0x09,0x06};
+static const uint8_t font_A[5]={0x7E,0x09,0x09,0x09,0x7E};
+static const uint8_t font_B[5]={0x7F,0x49,0x49,0x49,0x36};
+
+
+
+
+static const uint8_t font_a[5]={0x20,0x54,0x54,0x54,0x78};
+static const uint8_t font_c[5]={0x38,0x44,0x44,0x44,0x20};
+static const uint8_t font_d[5]={0x38,0x44,0x44,0x48,0x7F};
+static const uint8_t font_e[5]={0x38,0x54,0x54,0x54,0x18};
+static const uint8_t font_g[5]={0x18,0xA4,0xA4,0xA4,0x7C};
+static const uint8_t font_h[5]={0x7F,0x08,0x04,0x04,0x78};
+static const uint8_t font_i[5]={0x00,0x44,0x7D,0x40,0x00};
+static const uint8_t font_l[5]={0x00,0x41,0x7F,0x40,0x00};
+static const uint8_t font_m[5]={0x7C,0x04,0x18,0x04,0x78};
+static const uint8_t font_n[5]={0x7C,0x08,0x04,0x04,0x78};
+static const uint8_t font_o[5]={0x38,0x44,0x44,0x44,0x38};
+static const uint8_t font_p[5]={0x7C,0x14,0x14,0x14,0x08};
+static const uint8_t font_r[5]={0x7C,0x08,0x04,0x04,0x08};
+static const uint8_t font_s[5]={0x48,0x54,0x54,0x54,0x20};
+static const uint8_t font_t[5]={0x04,0x3F,0x44,0x40,0x20};
+static const uint8_t font_u[5]={0x3C,0x40,0x40,0x20,0x7C};
+static const uint8_t font_w[5]={0x3C,0x40,0x30,0x40,0x3C};
+static const uint8_t font_y[5]={0x0C,0x50,0x50,0x50,0x3C};
+static const uint8_t font_space[5] = {0,0,0,0,0};
+
+static const uint8_t font_percent[5] = {0x23, 0x13, 0x08, 0x64, 0x62};
+static const uint8_t font_deg[5] = {0x06, 0x09, 0x09, 0x06, 0x00};
+static const uint8_t font_dot[5] = {0x00,0x60,0x60,0x00,0x00};
+
+
+static const uint8_t icon_good[8]   = { 0x3C,0x42,0xA5,0x81,0xA5,0x99,0x42,0x3C };
+static const uint8_t icon_Mild[8] = { 0x3C,0x42,0xA5,0x81,0xBD,0x81,0x42,0x3C };
+static const uint8_t icon_bad[8]    = { 0x3C,0x42,0xA5,0x81,0x99,0xA5,0x42,0x3C };
+static const uint8_t icon_hot[8]    = { 0x3C,0x42,0xA5,0x81,0x9D,0xA1,0x42,0x3C };
+
+static const uint8_t* glyph_for_char(char c) {
+    if (c>='0' && c<='9') return font5x7_digits[c-'0'];
+
+    switch (c) {
+    case ':': return font_colon;
+
+    case 'E': return font_E;  case 'D': return font_D;  case 'I': return font_I;
+    case 'T': return font_T;  case 'R': return font_R;  case 'U': return font_U;
+    case 'N': return font_N;  case 'W': return font_W;  case 'H': return font_H;
+    case 'M': return font_M;  case 'S': return font_S;  case 'G': return font_G;
+    case 'P': return font_P;  case 'A': return font_A;  case 'B': return font_B;
+
+    case 'a': return font_a;  case 'c': return font_c;  case 'd': return font_d;
+    case 'e': return font_e;  case 'g': return font_g;  case 'h': return font_h;
+    case 'i': return font_i;  case 'l': return font_l;  case 'm': return font_m;
+    case 'n': return font_n;  case 'o': return font_o;  case 'p': return font_p;
+    case 'r': return font_r;  case 's': return font_s;  case 't': return font_t;
+    case 'u': return font_u;  case 'w': return font_w;  case 'y': return font_y;
+
+    case '%': return font_percent;
+    case '\xB0': return font_deg;      /* same byte whether char is signed or not */
+    case '.': return font_dot;
+    case ' ': return font_space;
+    }
+    return NULL;
+}
+
+/* glyph bytes are already columns in page order; row 7 is not part of the font */
+static void fb_draw_char5x7(int x, int y, char c, int scale) {
+    const uint8_t *g = glyph_for_char(c);
+    if (!g) return;
+    raster_blit(fb, x, y, g, 5, 7, scale);
+}
+
+void fb_draw_text(int x, int y, const char *s, int scale, int spacing) {
+    while (*s) {
+        fb_draw_char5x7(x, y, *s++, scale);
+        x += 5*scale + spacing;
+    }
+}
+
+void fb_draw_icon8(int x, int y, const uint8_t icon[8], int scale) {
+    uint8_t cols[8];
+
+    raster_icon_cols(icon, cols);
+    raster_blit(fb, x, y, cols, 8, 8, scale);
+}
+
+void fb_draw_circle(int cx,int cy,int r,int filled){
+    if (filled) raster_disc(fb, cx, cy, r);
+    else        raster_circle(fb, cx, cy, r);
+}
+
+void draw_page_dots(int page){
+    int cy=60,r=3;
+    for(int i=0;i<UI_PAGES;i++){
+        int cx=OLED_W/2+(i-UI_PAGES/2)*15;
+        fb_draw_circle(cx,cy,r,0);
+        if(i==page) fb_draw_circle(cx,cy,r-1,1);
+    }
+}
+
+void render_init(void) {
+    graph_init(&g_temp, GRAPH_TEMP, 1, 3);
+    graph_init(&g_hum,  GRAPH_HUM,  4, 3);
+    graph_init(&g_di,   GRAPH_DI,   1, 6);
+}
+
+void render_page(uint8_t *buf, int page, const struct clock_status *st, int blink,
+                 const struct render_data *d) {
+    fb = buf;
+    fb_clear();
+    draw_page_dots(page);
+
+    
+    if (page==0) {
+        if (strcmp(st->mode,"EDIT")==0)
+            fb_draw_text(0,0,"EDIT",1,1);
+        else
+            fb_draw_text(0,0,"RUN",1,1);
+
+        if (strcmp(st->mode,"EDIT")==0) {
+            char hs[3], ms[3], ss_s[3];
+            sprintf(hs,"%02d",st->hh);
+            sprintf(ms,"%02d",st->mm);
+            sprintf(ss_s,"%02d",st->ss);
+
+            if (!(strcmp(st->field,"HOUR")==0 && blink)) fb_draw_text(10,18,hs,2,2);
+            fb_draw_text(34,18,":",2,2);
+            if (!(strcmp(st->field,"MIN")==0 && blink)) fb_draw_text(46,18,ms,2,2);
+            fb_draw_text(70,18,":",2,2);
+            if (!(strcmp(st->field,"SEC")==0 && blink)) fb_draw_text(82,18,ss_s,2,2);
+        } else {
+            char ts[16];
+            sprintf(ts,"%02d:%02d:%02d",st->hh,st->mm,st->ss);
+            fb_draw_text(10,18,ts,2,2);
+        }
+    }
+
+    
+    else if (page==1) {
+        const int num_x=92;
+
+        fb_draw_text(0,0,"Today Weather",1,1);
+        fb_draw_text(0,20,"Temp:",1,1);
+        fb_draw_text(0,38,"Humidity:",1,1);
+
+        char tstr[12], hstr[12];
+        
+        if (d->temp >= 0) snprintf(tstr,sizeof(tstr),"%02d",d->temp);
+        else strcpy(tstr,"--");
+
+        if (d->hum >= 0) snprintf(hstr,sizeof(hstr),"%02d",d->hum);
+        else strcpy(hstr,"--");
+
+        fb_draw_text(num_x,16,tstr,2,2);
+        fb_draw_text(num_x+22,16,"\xB0",1,1);   
+        fb_draw_text(num_x+30,16,"C",1,1);      
+
+        fb_draw_text(num_x,34,hstr,2,2);
+        fb_draw_text(num_x+24,34,"%",1,1);     
+    }
+
+    
+    else if (page==2) {
+        int di = di_engine_value(d->di);
+
+        fb_draw_text(0,0,"DI PAGE",1,1);
+
+
+        char di_str[12];
+        if (di>=0) snprintf(di_str,sizeof(di_str),"%02d",di);
+        else strcpy(di_str,"--");
+
+        fb_draw_text(0,20,"DI:",2,2);        
+        fb_draw_text(40,20,di_str,2,2);    
+
+        if (d->di->cat == DI_NONE) {
+            fb_draw_text(40,14,"--",2,2);
+            fb_draw_text(0,36,"No Data",2,2);
+        }
+        else if (d->di->cat == DI_GOOD) {
+            fb_draw_icon8(90,20,icon_good,2);
+            fb_draw_text(0,36,"Good",2,2);
+        }
+        else if (d->di->cat == DI_MILD) {
+            fb_draw_icon8(90,20,icon_Mild,2);
+            fb_draw_text(0,36,"Mild",2,2);
+        }
+        else if (d->di->cat == DI_BAD) {
+            fb_draw_icon8(90,20,icon_bad,2);
+            fb_draw_text(0,36,"Bad",2,2);
+        }
+        else {
+            fb_draw_icon8(90,20,icon_hot,2);
+            fb_draw_text(0,36,"Hot",2,2);
+        }
+    }
+
+    
+    else {
+        int win = (st->win >= 0 && st->win < HIST_TIERS) ? st->win : 0;
+
+        fb_draw_text(0,0,(page==3) ? "Temp Hum" : "DI",1,1);
+        fb_draw_text(110,0,graph_win_label[win],1,1);
+
+        if (!d->hist) {
+            fb_draw_text(0,24,"No Data",2,2);
+        } else if (page==3) {
+            graph_update(&g_temp, d->hist, win);
+            graph_update(&g_hum, d->hist, win);
+            graph_blit(&g_temp, fb);
+            graph_blit(&g_hum, fb);
+        } else {
+            graph_update(&g_di, d->hist, win);
+            graph_blit(&g_di, fb);
+        }
+    }
+}
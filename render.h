@@ -0,0 +1,32 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdint.h>
+
+#include "clock_client.h"
+#include "di_engine.h"
+#include "history.h"
+
+#define UI_PAGES 5
+
+/* what the pages show besides the driver status line */
+struct render_data {
+    int temp, hum;                  /* last good DHT reading, -1 = none */
+    const struct di_engine *di;
+    const struct history *hist;     /* NULL: the graph pages show "No Data" */
+};
+
+/* drawing primitives work on the frame buffer set with fb_target() */
+void fb_target(uint8_t *buf);
+void fb_clear(void);
+void fb_set_px(int x, int y, int on);
+void fb_draw_text(int x, int y, const char *s, int scale, int spacing);
+void fb_draw_icon8(int x, int y, const uint8_t icon[8], int scale);
+void fb_draw_circle(int cx, int cy, int r, int filled);
+void draw_page_dots(int page);
+
+void render_init(void);
+void render_page(uint8_t *buf, int page, const struct clock_status *st, int blink,
+                 const struct render_data *d);
+
+#endif
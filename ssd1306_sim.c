@@ -0,0 +1,284 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "ssd1306_sim.h"
+#include "oled.h"
+
+void ssd1306_sim_reset(struct ssd1306_sim *s) {
+    memset(s, 0, sizeof(*s));
+    s->addr_mode = 2;
+    s->col_end = SSD1306_COLS - 1;
+    s->page_end = SSD1306_PAGES - 1;
+    s->mux = SSD1306_ROWS - 1;
+    s->contrast = 0x7F;
+}
+
+static int cmd_arg_count(uint8_t c) {
+    switch (c) {
+    case 0x81: case 0x20: case 0xA8: case 0xD3: case 0xDA:
+    case 0xD5: case 0xD9: case 0xDB: case 0x8D:
+        return 1;
+    case 0x21: case 0x22: case 0xA3:
+        return 2;
+    case 0x29: case 0x2A:
+        return 5;
+    case 0x26: case 0x27:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+static void sim_exec(struct ssd1306_sim *s) {
+    uint8_t c = s->cmd;
+    const uint8_t *a = s->args;
+
+    if (c <= 0x0F)                { s->col = (s->col & 0xF0) | c; return; }
+    if (c >= 0x10 && c <= 0x1F)   { s->col = (s->col & 0x0F) | ((c & 0x07) << 4); return; }
+    if (c >= 0x40 && c <= 0x7F)   { s->start_line = c & 0x3F; return; }
+    if (c >= 0xB0 && c <= 0xB7)   { s->page = c & 0x07; return; }
+
+    switch (c) {
+    case 0x20: s->addr_mode = a[0] & 0x03; break;
+    case 0x21:
+        s->col_start = a[0] & 0x7F; s->col_end = a[1] & 0x7F;
+        s->col = s->col_start;
+        break;
+    case 0x22:
+        s->page_start = a[0] & 0x07; s->page_end = a[1] & 0x07;
+        s->page = s->page_start;
+        break;
+    case 0x81: s->contrast = a[0]; break;
+    case 0xA0: case 0xA1: s->seg_remap = c & 1; break;
+    case 0xC0: case 0xC8: s->com_remap = (c >> 3) & 1; break;
+    case 0xA4: case 0xA5: s->entire_on = c & 1; break;
+    case 0xA6: case 0xA7: s->inverse = c & 1; break;
+    case 0xAE: case 0xAF: s->display_on = c & 1; break;
+    case 0xA8: s->mux = a[0] & 0x3F; break;
+    case 0xD3: s->offset = a[0] & 0x3F; break;
+    case 0x26: case 0x27: case 0x29: case 0x2A:
+        s->scroll_cmd = c;
+        memcpy(s->scroll_args, a, 6);
+        break;
+    case 0x2E: s->scroll_active = 0; break;
+    case 0x2F: s->scroll_active = 1; break;
+    case 0xA3: case 0xD5: case 0xD9: case 0xDA: case 0xDB: case 0x8D: case 0xE3:
+        break;
+    default:
+        s->unknown_cmds++;
+        break;
+    }
+}
+
+static void sim_cmd_byte(struct ssd1306_sim *s, uint8_t b) {
+    s->cmd_bytes++;
+    if (s->need > 0) {
+        s->args[s->got++] = b;
+        if (--s->need == 0) sim_exec(s);
+        return;
+    }
+    s->cmd = b;
+    s->got = 0;
+    s->need = cmd_arg_count(b);
+    if (s->need == 0) sim_exec(s);
+}
+
+static void sim_data_byte(struct ssd1306_sim *s, uint8_t b) {
+    s->data_bytes++;
+    s->gddram[s->page & 7][s->col & 0x7F] = b;
+
+    if (s->addr_mode == 0) {
+        if (++s->col > s->col_end) {
+            s->col = s->col_start;
+            if (++s->page > s->page_end) s->page = s->page_start;
+        }
+    } else if (s->addr_mode == 1) {
+        if (++s->page > s->page_end) {
+            s->page = s->page_start;
+            if (++s->col > s->col_end) s->col = s->col_start;
+        }
+    } else {
+        if (++s->col > SSD1306_COLS - 1) s->col = 0;
+    }
+}
+
+void ssd1306_sim_write(struct ssd1306_sim *s, const uint8_t *buf, size_t n) {
+    size_t i = 0;
+
+    s->transactions++;
+
+    /* Co=1 control bytes cover a single byte, then another control byte follows */
+    while (i < n) {
+        uint8_t ctl = buf[i++];
+        int data = ctl & 0x40;
+
+        if (ctl & 0x80) {
+            if (i < n) {
+                if (data) sim_data_byte(s, buf[i]);
+                else      sim_cmd_byte(s, buf[i]);
+                i++;
+            }
+            continue;
+        }
+        for (; i < n; i++) {
+            if (data) sim_data_byte(s, buf[i]);
+            else      sim_cmd_byte(s, buf[i]);
+        }
+    }
+}
+
+int ssd1306_sim_pixel(const struct ssd1306_sim *s, int x, int y) {
+    if (!s->display_on) return 0;
+    if (s->entire_on) return 1;
+
+    int col = s->seg_remap ? x : (SSD1306_COLS - 1 - x);
+    int com = s->com_remap ? y : (SSD1306_ROWS - 1 - y);
+    int row = (com + s->start_line) % SSD1306_ROWS;
+
+    int on = (s->gddram[row / 8][col] >> (row % 8)) & 1;
+    return on ^ s->inverse;
+}
+
+int ssd1306_sim_write_pbm(const struct ssd1306_sim *s, const char *path) {
+    char tmp[512];
+    uint8_t row[SSD1306_COLS / 8];
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) { perror(tmp); return -1; }
+
+    fprintf(f, "P4\n%d %d\n", SSD1306_COLS, SSD1306_ROWS);
+    for (int y = 0; y < SSD1306_ROWS; y++) {
+        memset(row, 0, sizeof(row));
+        for (int x = 0; x < SSD1306_COLS; x++) {
+            /* PBM 1 = black: draw lit pixels white on black like the panel */
+            if (!ssd1306_sim_pixel(s, x, y)) row[x / 8] |= 0x80 >> (x % 8);
+        }
+        fwrite(row, 1, sizeof(row), f);
+    }
+
+    if (fclose(f) != 0) { perror(tmp); return -1; }
+    return rename(tmp, path);
+}
+
+
+struct sim_priv {
+    struct ssd1306_sim sim;
+    long bus_hz;                /* 0 = no bus timing */
+    unsigned long frames;
+    char out[256];
+    int out_is_dir;
+};
+
+static int sim_open(struct oled *o, const char *arg) {
+    struct sim_priv *p = calloc(1, sizeof(*p));
+    if (!p) return -1;
+
+    ssd1306_sim_reset(&p->sim);
+    if (arg && *arg) p->bus_hz = atol(arg) * 1000L;
+    o->priv = p;
+    return 0;
+}
+
+static int sim_xfer(struct oled *o, const uint8_t *buf, size_t n) {
+    struct sim_priv *p = o->priv;
+
+    ssd1306_sim_write(&p->sim, buf, n);
+
+    if (p->bus_hz > 0) {
+        /* start + address byte + payload, 9 clocks per byte */
+        long long ns = (long long)(n + 1) * 9 * 1000000000LL / p->bus_hz + 2000;
+        struct timespec ts = { ns / 1000000000LL, ns % 1000000000LL };
+        nanosleep(&ts, NULL);
+    }
+    return 0;
+}
+
+static void sim_frame_done(struct oled *o) {
+    struct sim_priv *p = o->priv;
+    p->frames++;
+}
+
+static void sim_close(struct oled *o) {
+    struct sim_priv *p = o->priv;
+    if (!p) return;
+
+    fprintf(stderr, "%s: %lu frames, %lu transactions, %lu cmd bytes, %lu data bytes",
+            o->be->name, p->frames, p->sim.transactions, p->sim.cmd_bytes, p->sim.data_bytes);
+    if (p->frames)
+        fprintf(stderr, " (%.1f transactions, %.1f bytes per frame)",
+                (double)p->sim.transactions / p->frames,
+                (double)(p->sim.cmd_bytes + p->sim.data_bytes) / p->frames);
+    if (p->sim.unknown_cmds)
+        fprintf(stderr, ", %lu unknown commands", p->sim.unknown_cmds);
+    fputc('\n', stderr);
+
+    free(p);
+    o->priv = NULL;
+}
+
+const struct oled_backend oled_backend_sim = {
+    .name       = "sim",
+    .open       = sim_open,
+    .xfer       = sim_xfer,
+    .frame_done = sim_frame_done,
+    .close      = sim_close,
+};
+
+
+static int pbm_open(struct oled *o, const char *arg) {
+    if (sim_open(o, NULL) != 0) return -1;
+
+    struct sim_priv *p = o->priv;
+    size_t len;
+
+    if (!arg || !*arg) arg = ".";
+    snprintf(p->out, sizeof(p->out), "%s", arg);
+    len = strlen(p->out);
+    p->out_is_dir = !(len > 4 && strcmp(p->out + len - 4, ".pbm") == 0);
+
+    /* create the frame directory rather than fail on every frame */
+    if (p->out_is_dir) {
+        struct stat sb;
+        if (mkdir(p->out, 0755) != 0 && errno != EEXIST) {
+            perror(p->out);
+            goto fail;
+        }
+        if (stat(p->out, &sb) != 0 || !S_ISDIR(sb.st_mode)) {
+            fprintf(stderr, "%s: not a directory\n", p->out);
+            goto fail;
+        }
+    }
+    return 0;
+
+fail:
+    free(p);
+    o->priv = NULL;
+    return -1;
+}
+
+static void pbm_frame_done(struct oled *o) {
+    struct sim_priv *p = o->priv;
+    char path[300];
+
+    if (p->out_is_dir)
+        snprintf(path, sizeof(path), "%s/frame_%06lu.pbm", p->out, p->frames);
+    else
+        snprintf(path, sizeof(path), "%s", p->out);
+
+    ssd1306_sim_write_pbm(&p->sim, path);
+    p->frames++;
+}
+
+const struct oled_backend oled_backend_pbm = {
+    .name       = "pbm",
+    .open       = pbm_open,
+    .xfer       = sim_xfer,
+    .frame_done = pbm_frame_done,
+    .close      = sim_close,
+};
@@ -0,0 +1,52 @@
+#ifndef SSD1306_SIM_H
+#define SSD1306_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SSD1306_COLS  128
+#define SSD1306_PAGES 8
+#define SSD1306_ROWS  (SSD1306_PAGES * 8)
+
+/*
+ * Software model of an SSD1306 controller.  It consumes the same I2C
+ * transactions the panel would see (control byte + payload) and keeps
+ * GDDRAM and the addressing / remap / scroll registers up to date.
+ */
+struct ssd1306_sim {
+    uint8_t gddram[SSD1306_PAGES][SSD1306_COLS];
+
+    int addr_mode;                  /* 0 = horizontal, 1 = vertical, 2 = page */
+    int col_start, col_end;
+    int page_start, page_end;
+    int col, page;
+
+    int seg_remap, com_remap;
+    int start_line, offset, mux;
+    int contrast;
+    int display_on, inverse, entire_on;
+
+    int scroll_active;
+    uint8_t scroll_cmd;
+    uint8_t scroll_args[6];
+
+    /* command parser state, kept across transactions */
+    uint8_t cmd;
+    int need, got;
+    uint8_t args[6];
+
+    unsigned long transactions;
+    unsigned long cmd_bytes;
+    unsigned long data_bytes;
+    unsigned long unknown_cmds;
+};
+
+void ssd1306_sim_reset(struct ssd1306_sim *s);
+void ssd1306_sim_write(struct ssd1306_sim *s, const uint8_t *buf, size_t n);
+
+/* pixel as seen on the glass, after remap, start line, inverse and on/off */
+int  ssd1306_sim_pixel(const struct ssd1306_sim *s, int x, int y);
+
+int  ssd1306_sim_write_pbm(const struct ssd1306_sim *s, const char *path);
+
+#endif
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+
+static long long clock_us(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void put_varint(FILE *f, unsigned long long v) {
+    while (v >= 0x80) {
+        fputc((int)(v & 0x7F) | 0x80, f);
+        v >>= 7;
+    }
+    fputc((int)v, f);
+}
+
+/* time stamps never go backwards in the file */
+static void put_head(struct trace_writer *w, long long mono_us, enum trace_type type) {
+    long long t = mono_us - w->hdr.mono_us;
+
+    if (t < w->last_us) t = w->last_us;
+    put_varint(w->f, (unsigned long long)(t - w->last_us));
+    fputc(type, w->f);
+    w->last_us = t;
+}
+
+int trace_create(struct trace_writer *w, const char *path) {
+    memset(w, 0, sizeof(*w));
+
+    w->f = fopen(path, "wb");
+    if (!w->f) { perror(path); return -1; }
+
+    w->hdr.magic = TRACE_MAGIC;
+    w->hdr.version = TRACE_VERSION;
+    w->hdr.wall_us = clock_us(CLOCK_REALTIME);
+    w->hdr.mono_us = clock_us(CLOCK_MONOTONIC);
+    if (fwrite(&w->hdr, sizeof(w->hdr), 1, w->f) != 1) {
+        perror(path);
+        fclose(w->f);
+        w->f = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void trace_put_read(struct trace_writer *w, long long mono_us, const char *line, size_t n) {
+    size_t head = 0, tail = 0, lim;
+
+    if (!w->f) return;
+    if (n >= TRACE_LINE_MAX) n = TRACE_LINE_MAX - 1;
+
+    if (w->has_prev && n == w->prev_len && memcmp(line, w->prev, n) == 0) {
+        put_head(w, mono_us, TRACE_SAME);
+        return;
+    }
+
+    if (w->has_prev) {
+        lim = (n < w->prev_len) ? n : w->prev_len;
+        while (head < lim && line[head] == w->prev[head]) head++;
+        while (tail < lim - head && line[n-1-tail] == w->prev[w->prev_len-1-tail]) tail++;
+    }
+
+    put_head(w, mono_us, TRACE_READ);
+    fputc((int)head, w->f);
+    fputc((int)tail, w->f);
+    fputc((int)(n - head - tail), w->f);
+    fwrite(line + head, 1, n - head - tail, w->f);
+
+    memcpy(w->prev, line, n);
+    w->prev_len = n;
+    w->has_prev = 1;
+}
+
+void trace_put_fail(struct trace_writer *w, long long mono_us) {
+    if (!w->f) return;
+    put_head(w, mono_us, TRACE_FAIL);
+}
+
+void trace_put_write(struct trace_writer *w, long long mono_us, const char *buf, size_t n) {
+    if (!w->f) return;
+    if (n >= TRACE_LINE_MAX) n = TRACE_LINE_MAX - 1;
+    put_head(w, mono_us, TRACE_WRITE);
+    fputc((int)n, w->f);
+    fwrite(buf, 1, n, w->f);
+}
+
+void trace_finish(struct trace_writer *w) {
+    if (!w->f) return;
+    if (fclose(w->f) != 0) perror("trace");
+    w->f = NULL;
+}
+
+
+int trace_open(struct trace_reader *r, const char *path) {
+    struct stat sb;
+    FILE *f;
+
+    memset(r, 0, sizeof(*r));
+
+    f = fopen(path, "rb");
+    if (!f) { perror(path); return -1; }
+    if (fstat(fileno(f), &sb) != 0 || sb.st_size < (off_t)sizeof(r->hdr)) {
+        fprintf(stderr, "%s: not a trace\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    r->size = (size_t)sb.st_size;
+    r->buf = malloc(r->size);
+    if (!r->buf || fread(r->buf, 1, r->size, f) != r->size) {
+        perror(path);
+        free(r->buf);
+        r->buf = NULL;
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    memcpy(&r->hdr, r->buf, sizeof(r->hdr));
+    if (r->hdr.magic != TRACE_MAGIC || r->hdr.version != TRACE_VERSION) {
+        fprintf(stderr, "%s: not a trace or unsupported version\n", path);
+        trace_close(r);
+        return -1;
+    }
+    r->pos = sizeof(r->hdr);
+    return 0;
+}
+
+static int get_byte(struct trace_reader *r, unsigned *v) {
+    if (r->pos >= r->size) return -1;
+    *v = r->buf[r->pos++];
+    return 0;
+}
+
+int trace_next(struct trace_reader *r, struct trace_event *ev) {
+    unsigned long long dt = 0;
+    unsigned b, head, tail, n;
+    int shift = 0;
+
+    if (r->pos >= r->size) return 0;
+
+    do {
+        if (get_byte(r, &b) != 0 || shift > 56) return -1;
+        dt |= (unsigned long long)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+
+    if (get_byte(r, &b) != 0) return -1;
+    r->t_us += (long long)dt;
+    ev->t_us = r->t_us;
+    ev->type = (enum trace_type)b;
+    ev->len = 0;
+
+    switch (ev->type) {
+    case TRACE_READ:
+        if (get_byte(r, &head) || get_byte(r, &tail) || get_byte(r, &n)) return -1;
+        if (head + tail > r->line_len || head + n + tail >= TRACE_LINE_MAX ||
+            r->pos + n > r->size) return -1;
+        /* rebuild in data[] first: the tail comes from the old line */
+        memcpy(ev->data, r->line, head);
+        memcpy(ev->data + head, r->buf + r->pos, n);
+        memcpy(ev->data + head + n, r->line + r->line_len - tail, tail);
+        r->pos += n;
+        r->line_len = head + n + tail;
+        memcpy(r->line, ev->data, r->line_len);
+        ev->len = r->line_len;
+        break;
+    case TRACE_SAME:
+        memcpy(ev->data, r->line, r->line_len);
+        ev->len = r->line_len;
+        break;
+    case TRACE_FAIL:
+        break;
+    case TRACE_WRITE:
+        if (get_byte(r, &n) || n >= TRACE_LINE_MAX || r->pos + n > r->size) return -1;
+        memcpy(ev->data, r->buf + r->pos, n);
+        r->pos += n;
+        ev->len = n;
+        break;
+    default:
+        return -1;
+    }
+    ev->data[ev->len] = 0;
+    return 1;
+}
+
+void trace_close(struct trace_reader *r) {
+    free(r->buf);
+    r->buf = NULL;
+}
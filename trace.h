@@ -0,0 +1,73 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Binary trace of what a clock_client saw and sent.
+ *
+ * After the header every record is a varint time delta in microseconds,
+ * a type byte and, for READ and WRITE, a payload.  A READ only stores how
+ * the line differs from the previous one (bytes kept at the head, bytes
+ * kept at the tail, the new middle), so a ticking second costs a few
+ * bytes; a read that returned the same line again is a bare SAME record.
+ */
+#define TRACE_MAGIC    0x43525443u      /* "CTRC" */
+#define TRACE_VERSION  1
+#define TRACE_LINE_MAX 200
+
+enum trace_type {
+    TRACE_READ = 1,         /* head, tail, n, n bytes */
+    TRACE_SAME,             /* read returned the previous line */
+    TRACE_FAIL,             /* read failed (no device, broker gone) */
+    TRACE_WRITE,            /* n, n bytes of commands */
+};
+
+struct trace_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    int64_t  wall_us;       /* CLOCK_REALTIME at the start */
+    int64_t  mono_us;       /* CLOCK_MONOTONIC at the start */
+};
+
+struct trace_writer {
+    FILE *f;
+    struct trace_header hdr;
+    long long last_us;              /* relative to hdr.mono_us */
+    char prev[TRACE_LINE_MAX];
+    size_t prev_len;
+    int has_prev;
+};
+
+/* one decoded record; for READ and SAME data holds the whole line */
+struct trace_event {
+    long long t_us;                 /* relative to hdr.mono_us */
+    enum trace_type type;
+    char data[TRACE_LINE_MAX];
+    size_t len;
+};
+
+struct trace_reader {
+    uint8_t *buf;
+    size_t size, pos;
+    struct trace_header hdr;
+    long long t_us;
+    char line[TRACE_LINE_MAX];
+    size_t line_len;
+};
+
+int  trace_create(struct trace_writer *w, const char *path);
+void trace_put_read(struct trace_writer *w, long long mono_us, const char *line, size_t n);
+void trace_put_fail(struct trace_writer *w, long long mono_us);
+void trace_put_write(struct trace_writer *w, long long mono_us, const char *buf, size_t n);
+void trace_finish(struct trace_writer *w);
+
+int  trace_open(struct trace_reader *r, const char *path);
+/* 1 = event decoded, 0 = end of trace, -1 = corrupt */
+int  trace_next(struct trace_reader *r, struct trace_event *ev);
+void trace_close(struct trace_reader *r);
+
+#endif